@@ -0,0 +1,202 @@
+/* Shared counter benchmark built from the ex2/ex3/ex4 programs.
+ *
+ * The workload is the one from those programs: every thread sweeps over
+ * the whole of globalbuf incrementing each element.  Each thread starts
+ * its sweep at a different offset (wrapping around), so that the shared
+ * modes are not all fighting over the same stripe or line in lockstep and
+ * measure the technique rather than a pile-up.  The total number of
+ * increments is fixed and split between the threads, and it is run
+ * under each of:
+ *
+ *      mutex   one global pthread_mutex around every increment (ex4)
+ *      striped NUM_STRIPES mutexes; mutex s guards cache lines of counters
+ *              s, s+NUM_STRIPES, s+2*NUM_STRIPES, ... (16 lines each)
+ *      atomic  __atomic_fetch_add on the shared counter
+ *      shards  per-thread padded copies of globalbuf, summed at the end
+ *      static  each thread owns a contiguous range of globalbuf (ex3)
+ *
+ * for 1, 2, 4, ... threads, and the final counts are checked.  ex2's
+ * unsynchronised increment is not included as it gets the wrong answer.
+ *
+ * Usage: counters [max threads] [total increments]
+ */
+
+#include <assert.h>
+#include <stdlib.h>     // exit(3)
+#include <pthread.h>
+#include <stdio.h>      // printf and friends
+#include <stdint.h>     // uint64_t and friends
+#include <inttypes.h>   // PRIu64 and friends
+#include <string.h>     // memset(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+
+#define BUFLEN (8192)
+#define NUM_STRIPES (64)
+#define LINE_COUNTERS (64 / sizeof(uint64_t))
+
+enum{
+    MODE_MUTEX      =0,
+    MODE_STRIPED    =1,
+    MODE_ATOMIC     =2,
+    MODE_SHARDS     =3,
+    MODE_STATIC     =4,
+    NUM_MODES       =5
+};
+static const char *mode_names[NUM_MODES] = { "mutex", "striped", "atomic", "shards", "static" };
+
+struct stripe{
+    pthread_mutex_t mutex;
+} __attribute__((aligned(64)));
+
+uint64_t globalbuf[BUFLEN] __attribute__((aligned(64)));
+pthread_mutex_t mutex;
+struct stripe stripes[NUM_STRIPES];
+uint64_t (*shards)[BUFLEN];     // One per thread, each 64-byte aligned.
+
+static int mode;
+static uint64_t num_threads, passes;   // Full sweeps of globalbuf per thread.
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+void *Increment(void *threadid)
+{
+    uint64_t t = (uint64_t)threadid;
+    uint64_t i, j, p, lo, hi;
+    uint64_t start = BUFLEN * t / num_threads;
+    uint64_t *shard;
+
+    switch( mode ){
+    case MODE_MUTEX:
+        for( p=0; p<passes; p++ ){
+            for( j=0, i=start; j<BUFLEN; j++, i = i+1 < BUFLEN ? i+1 : 0 ){
+                pthread_mutex_lock( &mutex );
+                globalbuf[i]++;
+                pthread_mutex_unlock( &mutex );
+            }
+        }
+        break;
+    case MODE_STRIPED:
+        for( p=0; p<passes; p++ ){
+            for( j=0, i=start; j<BUFLEN; j++, i = i+1 < BUFLEN ? i+1 : 0 ){
+                pthread_mutex_t *m = &stripes[(i / LINE_COUNTERS) % NUM_STRIPES].mutex;
+                pthread_mutex_lock( m );
+                globalbuf[i]++;
+                pthread_mutex_unlock( m );
+            }
+        }
+        break;
+    case MODE_ATOMIC:
+        for( p=0; p<passes; p++ ){
+            for( j=0, i=start; j<BUFLEN; j++, i = i+1 < BUFLEN ? i+1 : 0 ){
+                __atomic_fetch_add( &globalbuf[i], 1, __ATOMIC_RELAXED );
+            }
+        }
+        break;
+    case MODE_SHARDS:
+        shard = shards[t];
+        for( p=0; p<passes; p++ ){
+            for( i=0; i<BUFLEN; i++ ){
+                shard[i]++;
+            }
+            // Keep the compiler from folding the passes into one add.
+            __asm__ volatile( "" ::: "memory" );
+        }
+        break;
+    case MODE_STATIC:
+        // Same total work: our slice gets every thread's share of passes.
+        lo = BUFLEN * t / num_threads;
+        hi = BUFLEN * (t+1) / num_threads;
+        for( p=0; p<passes*num_threads; p++ ){
+            for( i=lo; i<hi; i++ ){
+                globalbuf[i]++;
+            }
+            __asm__ volatile( "" ::: "memory" );
+        }
+        break;
+    }
+    pthread_exit(NULL);
+}
+
+// Run one configuration and return increments per second.
+static double run(uint64_t threads_to_run){
+    pthread_t threads[threads_to_run];
+    int rc;
+    uint64_t t, i;
+    double start, elapsed;
+
+    num_threads = threads_to_run;
+    memset( globalbuf, 0, sizeof(globalbuf) );
+    if( mode == MODE_SHARDS ){
+        memset( shards, 0, num_threads * sizeof(*shards) );
+    }
+
+    start = now();
+    for(t=0; t<num_threads; t++){
+        rc = pthread_create(&threads[t], NULL, Increment, (void *)t);
+        if (rc){
+            printf("ERROR; return code from pthread_create() is %d\n", rc);
+            exit(-1);
+        }
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    if( mode == MODE_SHARDS ){
+        for( t=0; t<num_threads; t++ ){
+            for( i=0; i<BUFLEN; i++ ){
+                globalbuf[i] += shards[t][i];
+            }
+        }
+    }
+    elapsed = now() - start;
+
+    for( i=0; i<BUFLEN; i++ ){
+        if( globalbuf[i] != passes * num_threads ){
+            fprintf( stderr, "%s: globalbuf[%" PRIu64 "] is %" PRIu64 ", expected %" PRIu64 "\n",
+                    mode_names[mode], i, globalbuf[i], passes * num_threads );
+            exit(-1);
+        }
+    }
+    return passes * num_threads * BUFLEN / elapsed;
+}
+
+int main (int argc, char *argv[]) {
+    uint64_t max_threads, total, t;
+    double ops, base;
+
+    max_threads = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2 * (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    total = argc > 2 ? strtoull( argv[2], NULL, 0 ) : 64ULL * 1024 * 1024;
+    assert( max_threads > 0 );
+
+    pthread_mutex_init( &mutex, NULL );
+    for( t=0; t<NUM_STRIPES; t++ ){
+        pthread_mutex_init( &stripes[t].mutex, NULL );
+    }
+    assert( ! posix_memalign( (void**)&shards, 64, max_threads * sizeof(*shards) ) );
+
+    fprintf( stdout, "%-8s %8s %14s %8s\n", "mode", "threads", "ops/s", "scaling" );
+    for( mode=0; mode<NUM_MODES; mode++ ){
+        base = 0.0;
+        for( t=1; t<=max_threads; t*=2 ){
+            // Round down to whole sweeps of globalbuf per thread.
+            passes = total / BUFLEN / t;
+            assert( passes > 0 );
+            ops = run( t );
+            base = base > 0.0 ? base : ops;
+            fprintf( stdout, "%-8s %8" PRIu64 " %14.0lf %8.2lf\n", mode_names[mode], t, ops, ops / base );
+        }
+    }
+
+    /* Last thing that main() should do */
+    free( shards );
+    for( t=0; t<NUM_STRIPES; t++ ){
+        pthread_mutex_destroy( &stripes[t].mutex );
+    }
+    pthread_mutex_destroy( &mutex );
+    return 0;
+}
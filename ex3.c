@@ -21,14 +21,12 @@ void *PrintHello(void *threadid)
         pthread_mutex_unlock( &mutex );
     }
     */
-    // 8192/5 = 1638
-
-    if( (uint64_t)(*threadid) == 0 ){
-        for( i=0; i<1638; i++ ){
-            globalbuf[i]++;
-        }
-    }else if( (uint64_t)(*threadid) == 0 ){
-        ...
+    // Each thread owns a contiguous slice; 8192/5 = 1638 and change.
+    uint64_t t = (uint64_t)threadid;
+    uint64_t lo = BUFLEN * t / NUM_THREADS;
+    uint64_t hi = BUFLEN * (t+1) / NUM_THREADS;
+    for( i=lo; i<hi; i++ ){
+        globalbuf[i]++;
     }
 
     pthread_exit(NULL);
@@ -0,0 +1,22 @@
+/* Layout of the plain grid files pjwarm -o writes and -i reads, and that
+ * jtile -o decodes tile files into: a struct grid_header followed by n*n
+ * doubles, row-major, all in host byte order.
+ */
+#ifndef GRIDFILE_H
+#define GRIDFILE_H
+
+#include <stdint.h>     // uint64_t and friends
+#include <string.h>     // memcmp(3)
+
+#define GRID_MAGIC      "JGRIDv1"
+
+struct grid_header{
+    char magic[8];
+    uint64_t n;
+};
+
+static inline int grid_header_ok(const struct grid_header *h){
+    return !memcmp( h->magic, GRID_MAGIC, sizeof(h->magic) ) && h->n >= 2;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/* Deadline-bounded solves through libjacobi.
+ *
+ * Solves pjacobi's problem once per budget, as a service with a latency
+ * target per request would, and reports how far each got: the sweeps
+ * done, the last delta, and the library's estimates of the decay rate,
+ * the distance still to the converged grid and the sweeps still to go.
+ * A last unbounded solve shows how many sweeps the estimates should have
+ * added up to.  The first request also calibrates the kernels.
+ *
+ * Usage: jbudget [n] [threads] [budget ms ...]
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // strtoull(3)
+#include "libjacobi.h"
+
+#define TARGET_DELTA (0.05)
+
+static const double default_budgets[] = { 50.0, 200.0, 500.0, 1000.0 };
+
+static void problem(jacobi_t *j){
+    uint64_t n = jacobi_size( j );
+    jacobi_reset( j );
+    jacobi_set_fixed( j, 0, 0, -100.0 );            // heat sink
+    jacobi_set_fixed( j, n-1, n-1, 100.0 );         // heat source
+}
+
+int main(int argc, char *argv[]){
+    uint64_t n, b, num_budgets;
+    unsigned num_threads;
+    double budget;
+    struct jacobi_progress p;
+    jacobi_t *j;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoul( argv[2], NULL, 0 ) : 0;
+    num_budgets = argc > 3 ? argc - 3 : sizeof(default_budgets) / sizeof(default_budgets[0]);
+
+    j = jacobi_create( n, num_threads );
+    assert( j );
+    fprintf( stdout, "n %" PRIu64 " threads %u target %lf\n", n, jacobi_threads( j ), TARGET_DELTA );
+
+    for( b=0; b<num_budgets; b++ ){
+        budget = argc > 3 ? strtod( argv[3+b], NULL ) : default_budgets[b];
+        problem( j );
+        jacobi_run_budget( j, TARGET_DELTA, budget / 1000.0, 0, &p );
+        fprintf( stdout, "budget %8.1lf ms time %8.1lf ms kernel %-6s iterations %5" PRIu64
+                " delta %lf rate %lf remaining %lf iterations left %.0lf\n",
+                budget, 1000.0 * p.seconds, jacobi_kernel_name( j ), p.steps,
+                p.delta, p.rate, p.remaining, p.steps_left );
+    }
+
+    problem( j );
+    jacobi_run_budget( j, TARGET_DELTA, HUGE_VAL, 0, &p );
+    fprintf( stdout, "unbounded         time %8.1lf ms kernel %-6s iterations %5" PRIu64 " delta %lf\n",
+            1000.0 * p.seconds, jacobi_kernel_name( j ), p.steps, p.delta );
+
+    jacobi_destroy( j );
+    return 0;
+}
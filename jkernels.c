@@ -0,0 +1,86 @@
+/* Throughput of libjacobi's uniform kernels.
+ *
+ * For each size, runs the same number of sweeps of pjacobi's problem with
+ * each kernel the context has: the generic runtime-n kernel, the generic
+ * one with streaming stores, and the kernel compiled for that n if it is
+ * one of the production sizes.  Reports time per sweep and updates per
+ * second relative to the generic kernel, checks that every kernel gives
+ * the same grid, and shows what JACOBI_KERNEL_AUTO settles on.
+ *
+ * Usage: jkernels [threads] [sweeps] [n ...]
+ */
+
+#include <assert.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcmp(3)
+#include <time.h>       // clock_gettime()
+#include "libjacobi.h"
+
+static const uint64_t default_sizes[] = { 1000, 1024, 2000, 4096 };
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+static void problem(jacobi_t *j){
+    uint64_t n = jacobi_size( j );
+    jacobi_reset( j );
+    jacobi_set_fixed( j, 0, 0, -100.0 );            // heat sink
+    jacobi_set_fixed( j, n-1, n-1, 100.0 );         // heat source
+}
+
+static void bench(uint64_t n, unsigned num_threads, uint64_t sweeps){
+    jacobi_t *j = jacobi_create( n, num_threads );
+    double *generic = malloc( n * n * sizeof(double) );
+    double start, elapsed, generic_time=0.0;
+    int kernel;
+
+    assert( j && generic );
+    for( kernel=JACOBI_KERNEL_PLAIN; kernel<JACOBI_NUM_KERNELS; kernel++ ){
+        if( jacobi_set_kernel( j, kernel ) ){
+            continue;
+        }
+        problem( j );
+        start = now();
+        jacobi_step( j, sweeps );
+        elapsed = now() - start;
+
+        if( kernel == JACOBI_KERNEL_PLAIN ){
+            generic_time = elapsed;
+            memcpy( generic, jacobi_view( j, NULL ), n * n * sizeof(double) );
+        }
+        fprintf( stdout, "n %5" PRIu64 " kernel %-10s sweep %9.3lf ms %8.1lf Mupdates/s speedup %.3lf results %s\n",
+                n, jacobi_kernel_name( j ), 1000.0 * elapsed / sweeps, (double)n * n * sweeps / elapsed / 1e6,
+                generic_time / elapsed,
+                memcmp( generic, jacobi_view( j, NULL ), n * n * sizeof(double) ) ? "differ" : "match" );
+    }
+
+    // Enough sweeps for auto to try every kernel.
+    jacobi_set_kernel( j, JACOBI_KERNEL_AUTO );
+    problem( j );
+    jacobi_step( j, 2 * JACOBI_NUM_KERNELS );
+    fprintf( stdout, "n %5" PRIu64 " auto picks %s\n", n, jacobi_kernel_name( j ) );
+
+    free( generic );
+    jacobi_destroy( j );
+}
+
+int main(int argc, char *argv[]){
+    unsigned num_threads;
+    uint64_t sweeps, s, num_sizes;
+
+    num_threads = argc > 1 ? strtoul( argv[1], NULL, 0 ) : 0;
+    sweeps = argc > 2 ? strtoull( argv[2], NULL, 0 ) : 20;
+    num_sizes = argc > 3 ? argc - 3 : sizeof(default_sizes) / sizeof(default_sizes[0]);
+    assert( sweeps > 0 );
+
+    for( s=0; s<num_sizes; s++ ){
+        bench( argc > 3 ? strtoull( argv[3+s], NULL, 0 ) : default_sizes[s], num_threads, sweeps );
+    }
+    return 0;
+}
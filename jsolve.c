@@ -0,0 +1,75 @@
+/* pjacobi's problem solved through libjacobi.
+ *
+ * Creates one context and solves the source/sink problem on it repeats
+ * times, as a service handling a stream of requests would, reporting the
+ * one-off cost of creating the context separately from each solve.
+ *
+ * Given a file, the last solution is saved there with jacobi_save_tiles(),
+ * exactly or, with a tolerance, to within that fraction of the target
+ * delta; jtile reads it back.
+ *
+ * Usage: jsolve [n] [threads] [repeats] [file] [tolerance]
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // strtoull(3)
+#include <time.h>       // clock_gettime()
+#include "libjacobi.h"
+
+#define TARGET_DELTA (0.05)
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+int main(int argc, char *argv[]){
+    uint64_t n, repeats, r, i, stride, count, bytes;
+    unsigned num_threads;
+    const double *g;
+    const char *out;
+    double start, sum, tolerance;
+    jacobi_t *j;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoul( argv[2], NULL, 0 ) : 0;
+    repeats = argc > 3 ? strtoull( argv[3], NULL, 0 ) : 3;
+    out = argc > 4 ? argv[4] : NULL;
+    tolerance = argc > 5 ? strtod( argv[5], NULL ) : 0.0;
+
+    start = now();
+    j = jacobi_create( n, num_threads );
+    assert( j );
+    fprintf( stdout, "n %" PRIu64 " threads %u create %lf\n", n, jacobi_threads( j ), now() - start );
+
+    for( r=0; r<repeats; r++ ){
+        start = now();
+        jacobi_reset( j );
+        jacobi_set_fixed( j, 0, 0, -100.0 );            // heat sink
+        jacobi_set_fixed( j, n-1, n-1, 100.0 );         // heat source
+        count = jacobi_run_until( j, TARGET_DELTA, 0 );
+
+        g = jacobi_view( j, &stride );
+        for( i=0, sum=0.0; i<n*stride; i++ ){
+            sum += fabs( g[i] );
+        }
+        fprintf( stdout, "solve %" PRIu64 " kernel %s iterations %" PRIu64 " delta %lf time %lf checksum %.12le\n",
+                r, jacobi_kernel_name( j ), count, jacobi_delta( j ), now() - start, sum );
+    }
+
+    if( out ){
+        start = now();
+        bytes = jacobi_save_tiles( j, out, 0, tolerance * TARGET_DELTA );
+        assert( bytes );
+        fprintf( stdout, "saved %s tolerance %le bytes %" PRIu64 " ratio %.2lf time %lf\n",
+                out, tolerance * TARGET_DELTA, bytes, (double)( n * n * sizeof(double) ) / bytes, now() - start );
+    }
+
+    jacobi_destroy( j );
+    return 0;
+}
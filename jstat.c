@@ -0,0 +1,137 @@
+/* Display the stats block a running pjacobi publishes.
+ *
+ *      PJACOBI_TELEMETRY=/pjacobi ./pjacobi &
+ *      ./jstat /pjacobi
+ *
+ * Every interval it prints the iteration, delta, ETA, the iteration rate
+ * and the slowest, median and fastest threads by iteration rate and the
+ * fraction of time they spent waiting at the delta barrier.  It only
+ * reads the segment, so it has no effect on the solver.
+ *
+ * Usage: jstat <segment name> [interval seconds]
+ */
+
+#include <assert.h>
+#include <stdint.h>     // uint64_t and friends
+#include <inttypes.h>   // PRIu64 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3), qsort(3)
+#include <fcntl.h>      // O_RDONLY
+#include <unistd.h>     // usleep(3)
+#include <time.h>       // clock_gettime()
+#include <sys/mman.h>   // shm_open(3), mmap(2)
+#include <sys/stat.h>   // fstat(2)
+#include "telemetry.h"
+
+struct thread_stats{
+    uint64_t id;
+    double rate;        // Iterations per second since the last sample.
+    double wait;        // Fraction of the last interval spent at the barrier.
+};
+
+static int by_rate(const void *a, const void *b){
+    const struct thread_stats *ta=a, *tb=b;
+    return ta->rate < tb->rate ? -1 : ta->rate > tb->rate;
+}
+
+static void print_thread(const char *label, const struct thread_stats *s){
+    fprintf( stdout, "  %-7s thread %5" PRIu64 " %10.1lf it/s wait %5.1lf%%\n",
+            label, s->id, s->rate, 100.0 * s->wait );
+}
+
+int main(int argc, char *argv[]){
+    struct telemetry *tm;
+    struct thread_stats *stats;
+    struct telemetry_thread *last;
+    struct stat st;
+    uint64_t t, num_threads, iteration, last_iteration=0;
+    uint64_t now_ns, last_ns;
+    double interval, elapsed, eta;
+    int fd;
+
+    if( argc < 2 ){
+        fprintf( stderr, "Usage: %s <segment name> [interval seconds]\n", argv[0] );
+        return 1;
+    }
+    interval = argc > 2 ? strtod( argv[2], NULL ) : 1.0;
+
+    fd = shm_open( argv[1], O_RDONLY, 0 );
+    if( fd == -1 ){
+        perror( argv[1] );
+        return 1;
+    }
+    assert( ! fstat( fd, &st ) );
+    if( (size_t)st.st_size < sizeof(struct telemetry) ){
+        fprintf( stderr, "%s: segment is too small\n", argv[1] );
+        return 1;
+    }
+    tm = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    assert( tm != MAP_FAILED );
+    close( fd );
+
+    if( __atomic_load_n( &tm->magic, __ATOMIC_ACQUIRE ) != TELEMETRY_MAGIC
+            || tm->version != TELEMETRY_VERSION
+            || telemetry_size( tm->num_threads ) > (size_t)st.st_size ){
+        fprintf( stderr, "%s: not a pjacobi stats block\n", argv[1] );
+        return 1;
+    }
+    num_threads = tm->num_threads;
+    stats = malloc( num_threads * sizeof(*stats) );
+    last = calloc( num_threads, sizeof(*last) );
+    assert( stats && last );
+
+    last_ns = tm->start_ns;
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " target %lf\n",
+            tm->n, num_threads, telemetry_load_double( &tm->target_delta ) );
+    while(1){
+        int done = telemetry_load( &tm->done );
+        struct timespec ts;
+
+        clock_gettime( CLOCK_REALTIME, &ts );
+        now_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        elapsed = ( now_ns - last_ns ) / 1e9;
+        last_ns = now_ns;
+
+        iteration = telemetry_load( &tm->iteration );
+        eta = telemetry_load_double( &tm->eta );
+        fprintf( stdout, "iteration %" PRIu64 " delta %lf %.1lf it/s eta ",
+                iteration, telemetry_load_double( &tm->delta ),
+                (iteration - last_iteration) / elapsed );
+        if( eta < 0.0 ){
+            fprintf( stdout, "unknown\n" );
+        }else{
+            fprintf( stdout, "%.0lf s\n", eta );
+        }
+        last_iteration = iteration;
+
+        for( t=0; t<num_threads; t++ ){
+            struct telemetry_thread now;
+            uint64_t calc, wait;
+            now.iterations = telemetry_load( &tm->threads[t].iterations );
+            now.calc_ns = telemetry_load( &tm->threads[t].calc_ns );
+            now.wait_ns = telemetry_load( &tm->threads[t].wait_ns );
+            calc = now.calc_ns - last[t].calc_ns;
+            wait = now.wait_ns - last[t].wait_ns;
+            stats[t].id = t;
+            stats[t].rate = (now.iterations - last[t].iterations) / elapsed;
+            stats[t].wait = calc + wait ? (double)wait / (calc + wait) : 0.0;
+            last[t] = now;
+        }
+        qsort( stats, num_threads, sizeof(*stats), by_rate );
+        print_thread( "slowest", &stats[0] );
+        print_thread( "median", &stats[num_threads/2] );
+        print_thread( "fastest", &stats[num_threads-1] );
+        fflush( stdout );
+
+        if( done ){
+            fprintf( stdout, "finished\n" );
+            break;
+        }
+        usleep( interval * 1000000 );
+    }
+
+    free( last );
+    free( stats );
+    munmap( tm, st.st_size );
+    return 0;
+}
@@ -0,0 +1,139 @@
+/* Read the compressed, tiled grid files written by jacobi_save_tiles().
+ *
+ * Prints the file's layout and compression ratio.  Given a cell x y it
+ * also prints the tile holding that cell, as print_grid() would, reading
+ * only the header, that tile's index entry and the tile itself.  With -o
+ * it decodes the whole grid into a file pjwarm -i can start from.
+ *
+ * Needs only tilefile.h, gridfile.h and zlib, not libjacobi.
+ *
+ * Usage: jtile [-o grid file] <tile file> [x y]
+ */
+
+#include <assert.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcpy(3)
+#include <unistd.h>     // getopt(3)
+#include <time.h>       // clock_gettime()
+#include "tilefile.h"
+#include "gridfile.h"
+
+static const char *codec_names[NUM_TILE_CODECS] = { "lossless", "quantized" };
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+// Read and decode tile i into out, rows stride apart.  Returns 0 or -1.
+static int read_tile(FILE *f, const struct tile_header *h, uint64_t i, void *data, void *scratch,
+        double *out, uint64_t stride){
+    struct tile_entry e;
+    uint64_t x0, y0, w, hgt;
+
+    if( fseek( f, sizeof(*h) + i * sizeof(e), SEEK_SET ) || fread( &e, sizeof(e), 1, f ) != 1 ||
+            e.size > tile_bound( h ) || fseek( f, e.offset, SEEK_SET ) || fread( data, 1, e.size, f ) != e.size ){
+        return -1;
+    }
+    tile_bounds( h, i, &x0, &y0, &w, &hgt );
+    return tile_decode( h, data, e.size, w, hgt, scratch, out, stride );
+}
+
+int main(int argc, char *argv[]){
+    struct tile_header h;
+    struct grid_header gh = { GRID_MAGIC, 0 };
+    const char *out=NULL;
+    uint64_t x, y, i, x0, y0, w, hgt;
+    double *g, start;
+    void *data, *scratch;
+    long size;
+    int opt;
+    FILE *f;
+
+    while( (opt = getopt( argc, argv, "o:" )) != -1 ){
+        switch( opt ){
+        case 'o': out = optarg;     break;
+        default:
+            fprintf( stderr, "Usage: %s [-o grid file] <tile file> [x y]\n", argv[0] );
+            return 1;
+        }
+    }
+    if( optind >= argc || ( argc - optind != 1 && argc - optind != 3 ) ){
+        fprintf( stderr, "Usage: %s [-o grid file] <tile file> [x y]\n", argv[0] );
+        return 1;
+    }
+    f = fopen( argv[optind], "rb" );
+    if( !f || fread( &h, sizeof(h), 1, f ) != 1 || !tile_header_ok( &h ) ){
+        fprintf( stderr, "%s: not a tile file\n", argv[optind] );
+        return 1;
+    }
+    fseek( f, 0, SEEK_END );
+    size = ftell( f );
+    fprintf( stdout, "n %" PRIu64 " tile %" PRIu64 " tiles %" PRIu64 " codec %s",
+            h.n, h.tile, tile_count( &h ), codec_names[h.codec] );
+    if( h.codec == TILE_QUANTIZED ){
+        fprintf( stdout, " tolerance %le", h.step / 2.0 );
+    }
+    fprintf( stdout, " bytes %ld ratio %.2lf\n", size, (double)( h.n * h.n * sizeof(double) ) / size );
+
+    data = malloc( tile_bound( &h ) );
+    scratch = malloc( tile_scratch( &h ) );
+    assert( data && scratch );
+
+    if( argc - optind == 3 ){
+        x = strtoull( argv[optind+1], NULL, 0 );
+        y = strtoull( argv[optind+2], NULL, 0 );
+        if( x >= h.n || y >= h.n ){
+            fprintf( stderr, "cell %" PRIu64 " %" PRIu64 " is outside the grid\n", x, y );
+            return 1;
+        }
+        i = y / h.tile * tile_per_row( &h ) + x / h.tile;
+        tile_bounds( &h, i, &x0, &y0, &w, &hgt );
+        g = malloc( w * hgt * sizeof(double) );
+        assert( g );
+        if( read_tile( f, &h, i, data, scratch, g, w ) ){
+            fprintf( stderr, "tile %" PRIu64 " is corrupt\n", i );
+            return 1;
+        }
+        fprintf( stdout, "tile %" PRIu64 " x %" PRIu64 "..%" PRIu64 " y %" PRIu64 "..%" PRIu64 "\n",
+                i, x0, x0+w-1, y0, y0+hgt-1 );
+        for( y=0; y<hgt; y++ ){
+            for( x=0; x<w; x++ ){
+                fprintf( stdout, "%05.1lf ", g[y*w + x] );
+            }
+            fprintf( stdout, "\n" );
+        }
+        fprintf( stdout, "\n" );
+        free( g );
+    }
+
+    if( out ){
+        g = malloc( h.n * h.n * sizeof(double) );
+        assert( g );
+        start = now();
+        for( i=0; i<tile_count( &h ); i++ ){
+            tile_bounds( &h, i, &x0, &y0, &w, &hgt );
+            if( read_tile( f, &h, i, data, scratch, &g[y0*h.n + x0], h.n ) ){
+                fprintf( stderr, "tile %" PRIu64 " is corrupt\n", i );
+                return 1;
+            }
+        }
+        fprintf( stdout, "decoded in %lf\n", now() - start );
+        fclose( f );
+
+        gh.n = h.n;
+        f = fopen( out, "wb" );
+        assert( f );
+        assert( fwrite( &gh, sizeof(gh), 1, f ) == 1 );
+        assert( fwrite( g, sizeof(double), h.n * h.n, f ) == h.n * h.n );
+        free( g );
+    }
+    fclose( f );
+    free( scratch );
+    free( data );
+    return 0;
+}
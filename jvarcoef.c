@@ -0,0 +1,115 @@
+/* Variable-coefficient sweeps through libjacobi.
+ *
+ * Runs the same number of sweeps of pjacobi's problem three ways: with the
+ * uniform average, with every conductivity set to 1 (which must give
+ * the uniform result to within rounding), and on a board made of FR4 with copper
+ * planes every 64 rows and an air gap cut through the middle.  For each it
+ * reports the time per sweep and a modelled memory bandwidth: 24 bytes per
+ * update for the uniform stencil (read the old value, write and
+ * write-allocate the new one) and 12 more for the float conductivity and
+ * double normalisation of the weighted one, divided by the time.  Nothing
+ * is measured, and the model only holds once the arrays are well past the
+ * LLC; pjstream measures the uniform stencil's real traffic.
+ *
+ * Usage: jvarcoef [n] [threads] [sweeps]
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcpy(3)
+#include <time.h>       // clock_gettime()
+#include "libjacobi.h"
+
+#define COPPER          400.0f  // W/mK
+#define FR4             0.3f
+#define AIR             0.026f
+#define PLANE_PITCH     64      // Rows from one copper plane to the next.
+#define PLANE_ROWS      2
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+static void board(float *k, uint64_t n){
+    uint64_t x, y;
+    for( y=0; y<n; y++ ){
+        for( x=0; x<n; x++ ){
+            k[y*n + x] = y % PLANE_PITCH < PLANE_ROWS ? COPPER : FR4;
+            // The gap runs down the middle and stops short of both edges.
+            if( x >= n/2 - 2 && x < n/2 + 2 && y >= n/8 && y < n - n/8 ){
+                k[y*n + x] = AIR;
+            }
+        }
+    }
+}
+
+// Run sweeps sweeps from scratch with the given conductivity and report them.
+static const double* run(jacobi_t *j, const char *name, const float *k, uint64_t sweeps, uint64_t bytes_per_update){
+    uint64_t n = jacobi_size( j ), i;
+    const double *g;
+    double start, elapsed, sum, delta;
+
+    jacobi_reset( j );
+    assert( ! jacobi_set_conductivity( j, k ) );
+    jacobi_set_fixed( j, 0, 0, -100.0 );            // heat sink
+    jacobi_set_fixed( j, n-1, n-1, 100.0 );         // heat source
+
+    start = now();
+    delta = jacobi_step( j, sweeps );
+    elapsed = now() - start;
+
+    g = jacobi_view( j, NULL );
+    for( i=0, sum=0.0; i<n*n; i++ ){
+        sum += fabs( g[i] );
+    }
+    fprintf( stdout, "%-8s sweep %lf ms modelled bytes/update %2" PRIu64 " GB/s %6.2lf delta %lf checksum %.12le\n",
+            name, 1000.0 * elapsed / sweeps, bytes_per_update,
+            (double)bytes_per_update * n * n * sweeps / elapsed / 1e9, delta, sum );
+    return g;
+}
+
+int main(int argc, char *argv[]){
+    uint64_t n, sweeps, i;
+    unsigned num_threads;
+    double *uniform, diff, max_diff=0.0;
+    const double *g;
+    float *k;
+    jacobi_t *j;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoul( argv[2], NULL, 0 ) : 0;
+    sweeps = argc > 3 ? strtoull( argv[3], NULL, 0 ) : 100;
+    assert( sweeps > 0 );
+
+    j = jacobi_create( n, num_threads );
+    k = malloc( n * n * sizeof(float) );
+    uniform = malloc( n * n * sizeof(double) );
+    assert( j && k && uniform );
+    fprintf( stdout, "n %" PRIu64 " threads %u sweeps %" PRIu64 "\n", n, jacobi_threads( j ), sweeps );
+
+    memcpy( uniform, run( j, "uniform", NULL, sweeps, 24 ), n * n * sizeof(double) );
+
+    for( i=0; i<n*n; i++ ){
+        k[i] = 1.0f;
+    }
+    g = run( j, "ones", k, sweeps, 36 );
+    for( i=0; i<n*n; i++ ){
+        diff = fabs( g[i] - uniform[i] );
+        max_diff = diff > max_diff ? diff : max_diff;
+    }
+    fprintf( stdout, "ones vs uniform max difference %le\n", max_diff );
+
+    board( k, n );
+    run( j, "board", k, sweeps, 36 );
+
+    jacobi_destroy( j );
+    free( uniform );
+    free( k );
+    return 0;
+}
@@ -0,0 +1,675 @@
+/* libjacobi: see libjacobi.h.
+ *
+ * The workers are created once per context and sleep on j->wake.  Every
+ * call that needs them sets j->job and bumps j->generation; each worker
+ * runs the job on its block of rows and the last one to finish wakes the
+ * caller.  Within a job the workers synchronise between sweeps with their
+ * own barrier, whose serial thread reduces the per-block deltas and swaps
+ * the grids.
+ *
+ * The serial thread also times every sweep.  That gives the budgeted runs
+ * their estimate of how long the next sweep will take, and lets
+ * JACOBI_KERNEL_AUTO try each kernel for CALIBRATE_SWEEPS sweeps and then
+ * settle on the fastest.  The calibration sweeps are real sweeps, so they
+ * cost nothing but the time lost to the slower kernel.
+ */
+
+#include <pthread.h>
+#include <float.h>      // FLT_MAX
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <stdio.h>      // fopen(3)
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memset(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+#include "tilefile.h"
+#include "libjacobi.h"
+
+#define CALIBRATE_SWEEPS (2)    // Per kernel, before JACOBI_KERNEL_AUTO picks one.
+#define DECAY_WINDOW (16)       // Sweeps of delta history used for the decay rate.
+#define DEFAULT_TILE (256)      // Cells along the edge of a saved tile.
+
+static const char *kernel_names[JACOBI_NUM_KERNELS] = { "auto", "plain", "stream", "sized" };
+
+typedef double (*row_fn)(const double *up, const double *mid, const double *down,
+        double *out, uint64_t n, unsigned fix);
+
+// Production sizes with a kernel compiled for them; the rest use stencil_row().
+STENCIL_ROW_SIZED(1024)
+STENCIL_ROW_SIZED(2000)
+STENCIL_ROW_SIZED(4096)
+STENCIL_ROW_SIZED(8192)
+
+static const struct sized_kernel{
+    uint64_t n;
+    const char *name;
+    row_fn row;
+} sized_kernels[] = {
+    { 1024, "sized-1024", stencil_row_1024 },
+    { 2000, "sized-2000", stencil_row_2000 },
+    { 4096, "sized-4096", stencil_row_4096 },
+    { 8192, "sized-8192", stencil_row_8192 },
+};
+
+struct fixed_cell{
+    uint64_t index;     // y*n + x
+    double value;
+};
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+struct saved_tile{
+    void *data;
+    size_t size;
+};
+
+struct worker_arg{
+    struct jacobi *j;
+    uint64_t t;
+};
+
+struct jacobi{
+    uint64_t n;
+    unsigned num_threads;
+    double *grid[2];
+    unsigned cur;                   // grid[cur] holds the current values.
+    uint64_t iterations;
+    double delta;
+
+    struct fixed_cell *fixed;       // Sorted by index.
+    uint64_t num_fixed, max_fixed;
+    uint64_t *row_first;            // fixed[row_first[y]..row_first[y+1]) are in row y.
+
+    float *k;                       // Conductivity, or NULL if uniform.
+    double *inv;                    // 1 / its sum over each neighbourhood.
+
+    const struct sized_kernel *sized;       // For n, or NULL if there isn't one.
+    int kernel;                     // As set by jacobi_set_kernel().
+    int active;                     // Used by the current sweep.
+    double kernel_time[JACOBI_NUM_KERNELS];         // Fastest sweep seen with each, for ranking.
+    double last_time[JACOBI_NUM_KERNELS];           // Latest sweep with each, for deadlines.
+    double last_sweep;              // Latest sweep with any kernel.
+    uint64_t kernel_sweeps[JACOBI_NUM_KERNELS];
+    double history[DECAY_WINDOW];   // Deltas of the last sweeps, by sweep number.
+    uint64_t history_count;         // Sweeps since the grid was last replaced.
+
+    pthread_t *threads;
+    struct worker_arg *args;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, idle;
+    uint64_t generation;            // Bumped for every job.
+    unsigned running;               // Workers still on the current job.
+    void (*job)(struct jacobi *j, uint64_t t);     // NULL tells workers to exit.
+    pthread_barrier_t step;
+    struct partial *partials;
+
+    // Parameters and state of the current run job.
+    uint64_t steps_wanted, steps_done;
+    double target_delta;
+    double deadline;                // CLOCK_MONOTONIC seconds, or 0 for none.
+    double sweep_start;
+    int stop;                       // Written only by the step barrier's serial thread.
+
+    // State of the current save job.
+    struct tile_header save_header;
+    struct saved_tile *saved;
+    uint64_t save_next;             // Next tile to claim.
+    int save_failed;
+};
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+// Have every worker run job on its rows and wait for them to finish.
+static void run_job(jacobi_t *j, void (*job)(jacobi_t *j, uint64_t t)){
+    pthread_mutex_lock( &j->lock );
+    j->job = job;
+    j->running = j->num_threads;
+    j->generation++;
+    pthread_cond_broadcast( &j->wake );
+    while( j->running ){
+        pthread_cond_wait( &j->idle, &j->lock );
+    }
+    pthread_mutex_unlock( &j->lock );
+}
+
+static void* worker(void *arg){
+    jacobi_t *j = ((struct worker_arg*)arg)->j;
+    uint64_t t = ((struct worker_arg*)arg)->t;
+    uint64_t seen=0;
+    void (*job)(jacobi_t *j, uint64_t t);
+
+    while(1){
+        pthread_mutex_lock( &j->lock );
+        while( j->generation == seen ){
+            pthread_cond_wait( &j->wake, &j->lock );
+        }
+        seen = j->generation;
+        job = j->job;
+        pthread_mutex_unlock( &j->lock );
+        if( !job ){
+            break;
+        }
+
+        job( j, t );
+
+        pthread_mutex_lock( &j->lock );
+        if( --j->running == 0 ){
+            pthread_cond_signal( &j->idle );
+        }
+        pthread_mutex_unlock( &j->lock );
+    }
+    return NULL;
+}
+
+// Stop and join the first num_started workers and free everything.
+static void teardown(jacobi_t *j, unsigned num_started){
+    unsigned t;
+
+    pthread_mutex_lock( &j->lock );
+    j->job = NULL;
+    j->generation++;
+    pthread_cond_broadcast( &j->wake );
+    pthread_mutex_unlock( &j->lock );
+    for( t=0; t<num_started; t++ ){
+        pthread_join( j->threads[t], NULL );
+    }
+
+    pthread_barrier_destroy( &j->step );
+    pthread_cond_destroy( &j->idle );
+    pthread_cond_destroy( &j->wake );
+    pthread_mutex_destroy( &j->lock );
+    free( j->inv );
+    free( j->k );
+    free( j->fixed );
+    free( j->partials );
+    free( j->args );
+    free( j->threads );
+    free( j->row_first );
+    free( j->grid[1] );
+    free( j->grid[0] );
+    free( j );
+}
+
+static void rows_of(const jacobi_t *j, uint64_t t, uint64_t *lo, uint64_t *hi){
+    *lo = j->n * t / j->num_threads;
+    *hi = j->n * (t+1) / j->num_threads;
+}
+
+// Zeroing by the workers also puts each block's pages on its worker's node.
+static void zero_job(jacobi_t *j, uint64_t t){
+    uint64_t lo, hi;
+    rows_of( j, t, &lo, &hi );
+    memset( &j->grid[0][lo*j->n], 0, (hi-lo) * j->n * sizeof(double) );
+    memset( &j->grid[1][lo*j->n], 0, (hi-lo) * j->n * sizeof(double) );
+}
+
+static void norm_job(jacobi_t *j, uint64_t t){
+    uint64_t lo, hi;
+    rows_of( j, t, &lo, &hi );
+    stencil_weight_norm( j->k, j->inv, j->n, lo, hi );
+}
+
+static double update_row(const jacobi_t *j, const double *src, double *dst, uint64_t y){
+    uint64_t n = j->n;
+    const double *up = y>0 ? &src[(y-1)*n] : NULL, *mid = &src[y*n], *down = y<n-1 ? &src[(y+1)*n] : NULL;
+
+    if( !j->k ){
+        switch( j->active ){
+        case JACOBI_KERNEL_STREAM:  return stencil_row_nt( up, mid, down, &dst[y*n], n, 0 );
+        case JACOBI_KERNEL_SIZED:   return j->sized->row( up, mid, down, &dst[y*n], n, 0 );
+        default:                    return stencil_row( up, mid, down, &dst[y*n], n, 0 );
+        }
+    }
+    return stencil_row_weighted( up, mid, down,
+            y>0 ? &j->k[(y-1)*n] : NULL, &j->k[y*n], y<n-1 ? &j->k[(y+1)*n] : NULL,
+            &j->inv[y*n], &dst[y*n], n, 0 );
+}
+
+static double sweep_row(const jacobi_t *j, const double *src, double *dst, uint64_t y){
+    uint64_t n = j->n, f = j->row_first[y], last = j->row_first[y+1], x;
+    const double *mid = &src[y*n];
+    double *out = &dst[y*n], d, max_delta=0.0;
+
+    if( f == last ){
+        return update_row( j, src, dst, y );
+    }
+    // Rare: put the fixed cells back and redo the delta without them.
+    update_row( j, src, dst, y );
+    for( ; f<last; f++ ){
+        out[j->fixed[f].index - y*n] = j->fixed[f].value;
+    }
+    for( x=0; x<n; x++ ){
+        d = fabs( out[x] - mid[x] );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    return max_delta;
+}
+
+// The kernel for the next sweep: an untried one while calibrating, else the fastest.
+static int pick_kernel(const jacobi_t *j){
+    int kernel, best = JACOBI_KERNEL_PLAIN;
+
+    if( j->kernel != JACOBI_KERNEL_AUTO ){
+        return j->kernel;
+    }
+    for( kernel=JACOBI_KERNEL_PLAIN; kernel<JACOBI_NUM_KERNELS; kernel++ ){
+        if( kernel == JACOBI_KERNEL_SIZED && !j->sized ){
+            continue;
+        }
+        if( j->kernel_sweeps[kernel] < CALIBRATE_SWEEPS ){
+            return kernel;
+        }
+        best = j->kernel_time[kernel] < j->kernel_time[best] ? kernel : best;
+    }
+    return best;
+}
+
+// Serial part of a sweep: runs on one worker while the others wait.
+static void end_sweep(jacobi_t *j){
+    double t = now(), elapsed = t - j->sweep_start, next;
+    uint64_t w;
+
+    j->delta = 0.0;
+    for( w=0; w<j->num_threads; w++ ){
+        j->delta = j->partials[w].delta > j->delta ? j->partials[w].delta : j->delta;
+    }
+    j->cur = !j->cur;
+    j->iterations++;
+    j->steps_done++;
+    j->history[j->history_count++ % DECAY_WINDOW] = j->delta;
+
+    // The weighted kernel is always used with conductivity, so don't time it as another.
+    if( !j->k ){
+        if( !j->kernel_sweeps[j->active]++ || elapsed < j->kernel_time[j->active] ){
+            j->kernel_time[j->active] = elapsed;
+        }
+        j->last_time[j->active] = elapsed;
+        j->active = pick_kernel( j );
+    }
+    // Assume the next sweep is no faster than the last one, nor than its kernel's last one.
+    next = !j->k && j->last_time[j->active] > elapsed ? j->last_time[j->active] : elapsed;
+    j->last_sweep = elapsed;
+
+    j->stop = j->steps_done >= j->steps_wanted || j->delta < j->target_delta ||
+        ( j->deadline > 0.0 && t + next > j->deadline );
+    j->sweep_start = t;
+}
+
+static void sweep_job(jacobi_t *j, uint64_t t){
+    uint64_t lo, hi, y;
+    double d, max_delta;
+
+    rows_of( j, t, &lo, &hi );
+    while(1){
+        const double *src = j->grid[j->cur];
+        double *dst = j->grid[!j->cur];
+
+        max_delta = 0.0;
+        for( y=lo; y<hi; y++ ){
+            d = sweep_row( j, src, dst, y );
+            max_delta = d > max_delta ? d : max_delta;
+        }
+        j->partials[t].delta = max_delta;
+#ifdef __SSE2__
+        if( j->active == JACOBI_KERNEL_STREAM ){
+            _mm_sfence();
+        }
+#endif
+
+        if( pthread_barrier_wait( &j->step ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            end_sweep( j );
+        }
+        pthread_barrier_wait( &j->step );
+        if( j->stop ){
+            break;
+        }
+    }
+}
+
+/* Workers claim tiles one at a time rather than taking their own rows, as
+ * the corners of a solution compress much worse than the middle.
+ */
+static void save_job(jacobi_t *j, uint64_t t){
+    const struct tile_header *h = &j->save_header;
+    uint64_t i, x0, y0, w, hgt;
+    void *scratch = malloc( tile_scratch( h ) ), *data;
+
+    if( !scratch ){
+        __atomic_store_n( &j->save_failed, 1, __ATOMIC_RELAXED );
+        return;
+    }
+    while( (i = __atomic_fetch_add( &j->save_next, 1, __ATOMIC_RELAXED )) < tile_count( h ) ){
+        tile_bounds( h, i, &x0, &y0, &w, &hgt );
+        j->saved[i].size = tile_bound( h );
+        j->saved[i].data = malloc( j->saved[i].size );
+        if( !j->saved[i].data ||
+                tile_encode( h, &j->grid[j->cur][y0*j->n + x0], j->n, w, hgt, scratch, j->saved[i].data, &j->saved[i].size ) ){
+            __atomic_store_n( &j->save_failed, 1, __ATOMIC_RELAXED );
+            continue;
+        }
+        // Keep only what the tile needs until they are all written.
+        data = realloc( j->saved[i].data, j->saved[i].size );
+        j->saved[i].data = data ? data : j->saved[i].data;
+    }
+    free( scratch );
+}
+
+static void rebuild_rows(jacobi_t *j){
+    uint64_t y, f=0;
+    for( y=0; y<=j->n; y++ ){
+        while( f < j->num_fixed && j->fixed[f].index < y * j->n ){
+            f++;
+        }
+        j->row_first[y] = f;
+    }
+}
+
+static uint64_t run(jacobi_t *j, double target_delta, uint64_t max_steps, double deadline){
+    if( max_steps == 0 ){
+        return 0;
+    }
+    j->steps_wanted = max_steps;
+    j->steps_done = 0;
+    j->target_delta = target_delta;
+    j->deadline = deadline;
+    j->stop = 0;
+    j->active = pick_kernel( j );
+    j->sweep_start = now();
+    run_job( j, sweep_job );
+    return j->steps_done;
+}
+
+jacobi_t* jacobi_create(uint64_t n, unsigned num_threads){
+    jacobi_t *j;
+    unsigned t;
+    uint64_t s;
+
+    if( n < 3 ){
+        return NULL;
+    }
+    if( num_threads == 0 ){
+        long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+        num_threads = cpus > 0 ? cpus : 1;
+    }
+    // Every worker needs at least one row.
+    num_threads = num_threads < n ? num_threads : n;
+
+    j = calloc( 1, sizeof(*j) );
+    if( !j ){
+        return NULL;
+    }
+    j->n = n;
+    j->num_threads = num_threads;
+    j->delta = HUGE_VAL;
+    j->kernel = JACOBI_KERNEL_AUTO;
+    for( s=0; s<sizeof(sized_kernels)/sizeof(sized_kernels[0]); s++ ){
+        j->sized = sized_kernels[s].n == n ? &sized_kernels[s] : j->sized;
+    }
+    // The sized kernels rely on rows starting on a cache line.
+    if( posix_memalign( (void**)&j->grid[0], 64, n * n * sizeof(double) ) ){
+        j->grid[0] = NULL;
+    }
+    if( posix_memalign( (void**)&j->grid[1], 64, n * n * sizeof(double) ) ){
+        j->grid[1] = NULL;
+    }
+    j->row_first = calloc( n+1, sizeof(uint64_t) );
+    j->threads = malloc( num_threads * sizeof(pthread_t) );
+    j->args = malloc( num_threads * sizeof(struct worker_arg) );
+    pthread_mutex_init( &j->lock, NULL );
+    pthread_cond_init( &j->wake, NULL );
+    pthread_cond_init( &j->idle, NULL );
+    pthread_barrier_init( &j->step, NULL, num_threads );
+    if( !j->grid[0] || !j->grid[1] || !j->row_first || !j->threads || !j->args ||
+            posix_memalign( (void**)&j->partials, 64, num_threads * sizeof(struct partial) ) ){
+        teardown( j, 0 );
+        return NULL;
+    }
+
+    for( t=0; t<num_threads; t++ ){
+        j->args[t].j = j;
+        j->args[t].t = t;
+        if( pthread_create( &j->threads[t], NULL, worker, &j->args[t] ) ){
+            teardown( j, t );
+            return NULL;
+        }
+    }
+    run_job( j, zero_job );
+    return j;
+}
+
+void jacobi_destroy(jacobi_t *j){
+    if( j ){
+        teardown( j, j->num_threads );
+    }
+}
+
+void jacobi_reset(jacobi_t *j){
+    run_job( j, zero_job );
+    j->cur = 0;
+    j->iterations = 0;
+    j->delta = HUGE_VAL;
+    j->history_count = 0;
+    j->num_fixed = 0;
+    rebuild_rows( j );
+}
+
+int jacobi_set_fixed(jacobi_t *j, uint64_t x, uint64_t y, double value){
+    uint64_t index = y * j->n + x, f;
+
+    if( x >= j->n || y >= j->n ){
+        return -1;
+    }
+    for( f=0; f<j->num_fixed && j->fixed[f].index < index; f++ ){
+    }
+    if( f == j->num_fixed || j->fixed[f].index != index ){
+        if( j->num_fixed == j->max_fixed ){
+            struct fixed_cell *more;
+            j->max_fixed = j->max_fixed ? 2 * j->max_fixed : 16;
+            more = realloc( j->fixed, j->max_fixed * sizeof(*more) );
+            if( !more ){
+                return -1;
+            }
+            j->fixed = more;
+        }
+        memmove( &j->fixed[f+1], &j->fixed[f], (j->num_fixed - f) * sizeof(*j->fixed) );
+        j->num_fixed++;
+        j->fixed[f].index = index;
+        rebuild_rows( j );
+    }
+    j->fixed[f].value = value;
+    // Both grids, so the cell never shows up in a delta.
+    j->grid[0][index] = value;
+    j->grid[1][index] = value;
+    return 0;
+}
+
+int jacobi_set_conductivity(jacobi_t *j, const float *k){
+    uint64_t i, cells = j->n * j->n;
+
+    if( !k ){
+        free( j->inv );
+        free( j->k );
+        j->k = NULL;
+        j->inv = NULL;
+        return 0;
+    }
+    for( i=0; i<cells; i++ ){
+        if( !( k[i] >= 0.0f && k[i] <= FLT_MAX ) ){
+            return -1;
+        }
+    }
+    if( !j->k ){
+        j->k = malloc( cells * sizeof(float) );
+        j->inv = malloc( cells * sizeof(double) );
+        if( !j->k || !j->inv ){
+            free( j->inv );
+            free( j->k );
+            j->k = NULL;
+            j->inv = NULL;
+            return -1;
+        }
+    }
+    memcpy( j->k, k, cells * sizeof(float) );
+    run_job( j, norm_job );
+    return 0;
+}
+
+void jacobi_set_grid(jacobi_t *j, const double *values){
+    uint64_t f;
+    memcpy( j->grid[j->cur], values, j->n * j->n * sizeof(double) );
+    for( f=0; f<j->num_fixed; f++ ){
+        j->grid[j->cur][j->fixed[f].index] = j->fixed[f].value;
+    }
+    j->delta = HUGE_VAL;
+    j->history_count = 0;
+}
+
+int jacobi_set_kernel(jacobi_t *j, int kernel){
+    if( kernel < 0 || kernel >= JACOBI_NUM_KERNELS || ( kernel == JACOBI_KERNEL_SIZED && !j->sized ) ){
+        return -1;
+    }
+    j->kernel = kernel;
+    return 0;
+}
+
+const char* jacobi_kernel_name(const jacobi_t *j){
+    if( j->k ){
+        return "weighted";
+    }
+    int kernel = pick_kernel( j );
+    return kernel == JACOBI_KERNEL_SIZED ? j->sized->name : kernel_names[kernel];
+}
+
+double jacobi_step(jacobi_t *j, uint64_t steps){
+    run( j, -1.0, steps, 0.0 );
+    return j->delta;
+}
+
+uint64_t jacobi_run_until(jacobi_t *j, double target_delta, uint64_t max_steps){
+    return run( j, target_delta, max_steps ? max_steps : UINT64_MAX, 0.0 );
+}
+
+/* Delta has settled into shrinking by a roughly constant factor per sweep
+ * by the time this is useful, so the rate over the last DECAY_WINDOW
+ * sweeps predicts the rest: the sweeps still to go are a geometric
+ * series, and so is the distance left, which sums the changes to come.
+ */
+uint64_t jacobi_run_budget(jacobi_t *j, double target_delta, double seconds, uint64_t max_steps,
+        struct jacobi_progress *p){
+    double start = now(), oldest;
+    uint64_t steps=0;
+
+    // Don't start a sweep that is already known not to fit.
+    if( seconds > 0.0 && j->last_sweep < seconds ){
+        steps = run( j, target_delta, max_steps ? max_steps : UINT64_MAX, start + seconds );
+    }
+    if( p ){
+        p->steps = steps;
+        p->seconds = now() - start;
+        p->delta = j->delta;
+        p->rate = 0.0;
+        p->remaining = HUGE_VAL;
+        p->steps_left = HUGE_VAL;
+        if( j->delta < target_delta ){
+            p->steps_left = 0.0;
+        }
+        if( j->history_count >= DECAY_WINDOW ){
+            oldest = j->history[(j->history_count - DECAY_WINDOW) % DECAY_WINDOW];
+            if( j->delta > 0.0 && j->delta < oldest ){
+                p->rate = pow( j->delta / oldest, 1.0 / (DECAY_WINDOW-1) );
+                p->remaining = j->delta * p->rate / ( 1.0 - p->rate );
+                if( j->delta >= target_delta ){
+                    p->steps_left = ceil( log( target_delta / j->delta ) / log( p->rate ) );
+                }
+            }
+        }
+    }
+    return steps;
+}
+
+uint64_t jacobi_save_tiles(jacobi_t *j, const char *path, uint64_t tile, double tolerance){
+    struct tile_header *h = &j->save_header;
+    struct tile_entry e;
+    uint64_t i, count, bytes=0;
+    FILE *f;
+
+    if( tolerance < 0.0 ){
+        return 0;
+    }
+    memset( h, 0, sizeof(*h) );
+    memcpy( h->magic, TILE_MAGIC, sizeof(h->magic) );
+    h->n = j->n;
+    h->tile = tile ? tile : DEFAULT_TILE;
+    h->tile = h->tile < j->n ? h->tile : j->n;
+    h->codec = tolerance > 0.0 ? TILE_QUANTIZED : TILE_LOSSLESS;
+    // Rounding to the nearest multiple of step is off by at most step/2.
+    h->step = 2.0 * tolerance;
+    count = tile_count( h );
+
+    j->saved = calloc( count, sizeof(*j->saved) );
+    if( !j->saved ){
+        return 0;
+    }
+    j->save_next = 0;
+    j->save_failed = 0;
+    run_job( j, save_job );
+
+    f = j->save_failed ? NULL : fopen( path, "wb" );
+    if( f ){
+        bytes = sizeof(*h) + count * sizeof(e);
+        if( fwrite( h, sizeof(*h), 1, f ) != 1 ){
+            bytes = 0;
+        }
+        for( i=0; i<count && bytes; i++ ){
+            e.offset = bytes;
+            e.size = j->saved[i].size;
+            bytes = fwrite( &e, sizeof(e), 1, f ) == 1 ? bytes + e.size : 0;
+        }
+        for( i=0; i<count && bytes; i++ ){
+            if( fwrite( j->saved[i].data, 1, j->saved[i].size, f ) != j->saved[i].size ){
+                bytes = 0;
+            }
+        }
+        if( fclose( f ) || !bytes ){
+            remove( path );
+            bytes = 0;
+        }
+    }
+    for( i=0; i<count; i++ ){
+        free( j->saved[i].data );
+    }
+    free( j->saved );
+    j->saved = NULL;
+    return bytes;
+}
+
+const double* jacobi_view(const jacobi_t *j, uint64_t *stride){
+    if( stride ){
+        *stride = j->n;
+    }
+    return j->grid[j->cur];
+}
+
+uint64_t jacobi_size(const jacobi_t *j){
+    return j->n;
+}
+
+unsigned jacobi_threads(const jacobi_t *j){
+    return j->num_threads;
+}
+
+uint64_t jacobi_iterations(const jacobi_t *j){
+    return j->iterations;
+}
+
+double jacobi_delta(const jacobi_t *j){
+    return j->delta;
+}
@@ -0,0 +1,145 @@
+/* libjacobi: the pjacobi solver as a reusable library.
+ *
+ * A context owns an n x n grid pair and a pool of worker threads that
+ * live as long as the context does, so repeated solves on the same
+ * context cost only the sweeps themselves:
+ *
+ *      jacobi_t *j = jacobi_create( 2000, 8 );
+ *      for( each request ){
+ *          jacobi_reset( j );
+ *          jacobi_set_fixed( j, 0, 0, -100.0 );
+ *          jacobi_set_fixed( j, 1999, 1999, 100.0 );
+ *          jacobi_run_until( j, 0.05, 0 );
+ *          use( jacobi_view( j ) );
+ *      }
+ *      jacobi_destroy( j );
+ *
+ * Cells are addressed as (x,y) and stored row-major, g[y*n + x].  A
+ * cell's new value is the average of itself and its in-bounds neighbours,
+ * as in calculate_avg(), or a weighted one (jacobi_set_conductivity());
+ * fixed cells keep their value.  A context must
+ * only be used by one thread at a time.
+ */
+#ifndef LIBJACOBI_H
+#define LIBJACOBI_H
+
+#include <stdint.h>     // uint64_t and friends
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jacobi jacobi_t;
+
+/* Create a context for an n x n grid (n >= 3) solved by num_threads
+ * workers; 0 means one per online CPU.  The grid starts zeroed with no
+ * fixed cells.  Returns NULL on bad arguments or if memory or threads
+ * can't be had.
+ */
+jacobi_t* jacobi_create(uint64_t n, unsigned num_threads);
+void jacobi_destroy(jacobi_t *j);
+
+// Zero the grid, drop all fixed cells and the iteration count.
+void jacobi_reset(jacobi_t *j);
+
+// Hold (x,y) at value from now on.  Returns 0, or -1 if out of range.
+int jacobi_set_fixed(jacobi_t *j, uint64_t x, uint64_t y, double value);
+
+/* Give every cell a conductivity k[y*n + x] >= 0 (n*n values, copied),
+ * so that a cell's new value is the k-weighted average of itself and its
+ * in-bounds neighbours: copper next to FR4 next to an air gap, say.  Only
+ * ratios matter; a cell whose neighbourhood has no weight at all keeps
+ * its value.  NULL goes back to the uniform average.  The weights are
+ * kept as floats next to a precomputed double 1/sum per cell, so each
+ * update reads 12 more bytes than a uniform one.  Returns 0, or -1 if a
+ * weight is negative, infinite or NaN or memory can't be had.
+ */
+int jacobi_set_conductivity(jacobi_t *j, const float *k);
+
+/* Kernels for the uniform average.  All give bitwise identical results;
+ * the stream kernel skips reading the output grid into cache, which pays
+ * once the grids are too big for the cache, and the sized kernels are
+ * compiled for one n each (1024, 2000, 4096 and 8192).  AUTO, the default,
+ * times each one available over its first few sweeps and then keeps the
+ * fastest.  With conductivity set the weighted kernel is always used.
+ */
+enum{
+    JACOBI_KERNEL_AUTO      =0,
+    JACOBI_KERNEL_PLAIN     =1,
+    JACOBI_KERNEL_STREAM    =2,
+    JACOBI_KERNEL_SIZED     =3,
+    JACOBI_NUM_KERNELS
+};
+
+// Returns 0, or -1 if kernel isn't one of the above or has no version for n.
+int jacobi_set_kernel(jacobi_t *j, int kernel);
+
+// The kernel used for the next sweep, e.g. "stream" or "sized-2000".
+const char* jacobi_kernel_name(const jacobi_t *j);
+
+/* Replace the current grid with n*n row-major values, e.g. a previous
+ * solution to warm start from.  Fixed cells keep their fixed value.
+ */
+void jacobi_set_grid(jacobi_t *j, const double *values);
+
+// Run exactly steps sweeps.  Returns the max change of the last one.
+double jacobi_step(jacobi_t *j, uint64_t steps);
+
+/* Sweep until the max change of a sweep is below target_delta, or
+ * max_steps sweeps have been done (0 means no limit).  Returns the
+ * number of sweeps done.
+ */
+uint64_t jacobi_run_until(jacobi_t *j, double target_delta, uint64_t max_steps);
+
+struct jacobi_progress{
+    uint64_t steps;         // Sweeps done by this call.
+    double seconds;         // Time taken by this call.
+    double delta;           // Max change of the last sweep.
+    double rate;            // Delta shrinks by this factor per sweep, or 0 if not known yet.
+    double remaining;       // Estimated max distance from the converged grid, or HUGE_VAL.
+    double steps_left;      // Estimated sweeps until delta < target_delta, or HUGE_VAL.
+};
+
+/* jacobi_run_until() that also gives up once seconds have passed.  A
+ * sweep is only started if it will finish in time assuming it takes as
+ * long as the last one (or the last one with its kernel, if longer), so
+ * the call returns within the budget give or take one sweep's variation;
+ * the grid is then left as the last sweep made it, which is the closest
+ * yet to the solution.  If p is not NULL it is filled in with how far the
+ * call got and estimates, from the recent decay of delta, of how far it
+ * still had to go.  The estimates need a few sweeps of history since the
+ * last reset or jacobi_set_grid(), so calling this again on the same
+ * problem picks up where the last call left off.  Returns the number of
+ * sweeps done.
+ */
+uint64_t jacobi_run_budget(jacobi_t *j, double target_delta, double seconds, uint64_t max_steps,
+        struct jacobi_progress *p);
+
+/* The current grid, without copying.  *stride (if not NULL) is set to
+ * the distance between rows in doubles.  The pointer stays valid until
+ * the next call that modifies the context.
+ */
+const double* jacobi_view(const jacobi_t *j, uint64_t *stride);
+
+/* Write the current grid to path in the compressed, tiled format of
+ * tilefile.h, the workers compressing the tiles in parallel.  tile is the
+ * edge of a tile in cells; 0 means 256.  With tolerance 0 the grid is
+ * saved exactly, otherwise every value may be off by up to tolerance
+ * (give or take rounding), which compresses much better.  No cell of a
+ * grid solved to target_delta is known much closer than that, so a
+ * fraction of target_delta is a reasonable tolerance.  Returns the size
+ * of the file, or 0 if it couldn't be written or a value is too large to
+ * keep to tolerance.
+ */
+uint64_t jacobi_save_tiles(jacobi_t *j, const char *path, uint64_t tile, double tolerance);
+
+uint64_t jacobi_size(const jacobi_t *j);
+unsigned jacobi_threads(const jacobi_t *j);
+uint64_t jacobi_iterations(const jacobi_t *j);  // Since the last reset.
+double jacobi_delta(const jacobi_t *j);         // Of the last sweep.
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
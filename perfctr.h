@@ -0,0 +1,147 @@
+/* Per-thread hardware performance counters via perf_event_open(2).
+ *
+ * perfctr_open() opens a group of counters on the calling thread.  The
+ * solver then calls perfctr_sample() at every phase boundary, which
+ * reads the whole group with one read(2) and adds what was counted
+ * since the previous sample to that phase's totals.  When the kernel
+ * multiplexes groups because there are more than the PMU can hold, a
+ * group only counts part of the time; each interval's counts are scaled
+ * up by how long the group was enabled over how long it actually ran,
+ * and running/enabled says how much of the total was really counted.
+ *
+ * Counters are often unavailable: no PMU in a VM or container, a high
+ * perf_event_paranoid, or running out of file descriptors with one
+ * group per thread.  perfctr_open() then returns 0 and every other call
+ * becomes a no-op, so callers need no special cases.  Events the CPU
+ * doesn't support are left out of the group and reported as such.
+ */
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <errno.h>
+#include <stdint.h>     // uint64_t and friends
+#include <string.h>     // memset(3)
+#include <unistd.h>     // syscall(2), read(2)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+enum{
+    PERFCTR_CYCLES      =0,     // Group leader.
+    PERFCTR_STALLED     =1,     // Backend stall cycles.
+    PERFCTR_LLC_REFS    =2,
+    PERFCTR_LLC_MISSES  =3,
+    PERFCTR_DTLB_MISSES =4,
+    PERFCTR_NUM_EVENTS  =5
+};
+
+static const char *perfctr_names[PERFCTR_NUM_EVENTS] __attribute__((unused)) = {
+    "cycles", "stalled-cycles", "llc-refs", "llc-misses", "dtlb-misses"
+};
+
+struct perfctr{
+    int fd[PERFCTR_NUM_EVENTS];     // -1 if the event isn't in the group.
+    int nopen;
+    int error;                      // errno from opening the leader, if that failed.
+    uint64_t last[PERFCTR_NUM_EVENTS];
+    uint64_t enabled, running;      // ns the group was enabled and on the PMU.
+};
+
+static inline void perfctr_attr(struct perf_event_attr *attr, int event){
+    memset( attr, 0, sizeof(*attr) );
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr->exclude_kernel = 1;   // Allowed at perf_event_paranoid 2.
+    attr->exclude_hv = 1;
+    switch( event ){
+    case PERFCTR_CYCLES:
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        attr->disabled = 1;     // The group starts when the leader is enabled.
+        break;
+    case PERFCTR_STALLED:
+        attr->config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+        break;
+    case PERFCTR_LLC_REFS:
+        attr->config = PERF_COUNT_HW_CACHE_REFERENCES;
+        break;
+    case PERFCTR_LLC_MISSES:
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PERFCTR_DTLB_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_DTLB |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    }
+}
+
+/* Open and start the counters for the calling thread.  Returns the
+ * number of events counted, or 0 with p->error set if the leader couldn't
+ * be opened.
+ */
+static inline int perfctr_open(struct perfctr *p){
+    struct perf_event_attr attr;
+    int e;
+
+    memset( p, 0, sizeof(*p) );
+    for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+        perfctr_attr( &attr, e );
+        p->fd[e] = syscall( SYS_perf_event_open, &attr, 0, -1, e == PERFCTR_CYCLES ? -1 : p->fd[PERFCTR_CYCLES], 0 );
+        if( p->fd[e] == -1 && e == PERFCTR_CYCLES ){
+            p->error = errno;
+            return 0;
+        }
+        p->nopen += p->fd[e] != -1;
+    }
+    ioctl( p->fd[PERFCTR_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( p->fd[PERFCTR_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+    return p->nopen;
+}
+
+// Add the counts since the last sample to phase[] and start a new interval.
+static inline void perfctr_sample(struct perfctr *p, uint64_t phase[PERFCTR_NUM_EVENTS]){
+    // nr, time enabled, time running, then one value per event.
+    uint64_t buf[3 + PERFCTR_NUM_EVENTS];
+    uint64_t i, count, enabled, running;
+    int e;
+
+    if( !p->nopen || read( p->fd[PERFCTR_CYCLES], buf, sizeof(buf) ) <= 0 ){
+        return;
+    }
+    enabled = buf[1] - p->enabled;
+    running = buf[2] - p->running;
+    p->enabled = buf[1];
+    p->running = buf[2];
+    // Values come back in the order the events joined the group.
+    for( i=0, e=0; i<buf[0] && e<PERFCTR_NUM_EVENTS; e++ ){
+        if( p->fd[e] == -1 ){
+            continue;
+        }
+        count = buf[3+i] - p->last[e];
+        p->last[e] = buf[3+i];
+        // Nothing was counted if the group never ran; running says so.
+        if( running && running < enabled ){
+            count = (uint64_t)( (double)count * enabled / running );
+        }
+        phase[e] += count;
+        i++;
+    }
+}
+
+static inline void perfctr_close(struct perfctr *p){
+    int e;
+    if( !p->nopen ){
+        return;
+    }
+    ioctl( p->fd[PERFCTR_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+    for( e=PERFCTR_NUM_EVENTS-1; e>=0; e-- ){
+        if( p->fd[e] != -1 ){
+            close( p->fd[e] );
+        }
+    }
+    p->nopen = 0;
+}
+
+#endif
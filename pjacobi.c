@@ -21,11 +21,24 @@
 #include <stdint.h>     // uint32_t and friends
 #include <inttypes.h>   // PRIu32 and friends
 #include <stdio.h>      // printf and friends
+#include <stdlib.h>     // getenv(3)
+#include <string.h>     // strerror(3)
+#include <errno.h>
+#include <fcntl.h>      // O_CREAT and friends
+#include <unistd.h>     // ftruncate(2)
+#include <time.h>       // clock_gettime()
+#include <sys/mman.h>   // shm_open(3), mmap(2)
+#include <sys/resource.h> // setrlimit(2)
 #include <sys/time.h>   // gettimeofday()
+#include "telemetry.h"
+#include "perfctr.h"
 
 #define N (2000ULL)
 #define NUM_THREADS (N + 3) // One per row + 2 for first and last column + 1 for corners.
 #define NUMGRIDS (2ULL) 
+#define TARGET_DELTA (0.05)
+#define ETA_SAMPLES (64)    // Deltas kept for the ETA, spread evenly over the run so far.
+#define ETA_SPREAD (0.1)    // How far the ETA's fits over two quarters may disagree.
 
 double grid[NUMGRIDS][N][N];
 
@@ -36,6 +49,23 @@ enum{
 };
 static pthread_barrier_t barrier[NUM_BARRIERS];
 
+// Phases that hardware counters are attributed to when PJACOBI_PERF is set.
+enum{
+    PHASE_CALC          =0,
+    PHASE_DELTA         =1,
+    PHASE_BARRIER       =2,
+    NUM_PHASES          =3
+};
+static const char *phase_names[NUM_PHASES] = { "calc", "delta", "barrier" };
+static int perf_enabled;
+static uint64_t perf_totals[NUM_PHASES][PERFCTR_NUM_EVENTS];
+static uint64_t perf_threads;                   // Threads that got counters.
+static uint64_t perf_unscheduled;               // Threads whose counters never ran.
+static uint64_t perf_time_enabled, perf_time_running;     // ns, summed over those threads.
+static int perf_events[PERFCTR_NUM_EVENTS];     // Counted on some thread.
+static int perf_errno;                          // Why a thread got none.
+static pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void initialize_grid(){
     uint32_t grid_idx, x, y;
     for( grid_idx=0; grid_idx < NUMGRIDS; grid_idx++ ){
@@ -197,14 +227,195 @@ double calculate_delta(){
 
 static double delta = 0.0;  // Only thread 0 is allowed to write to this.
 
+static struct telemetry *telemetry;
+static const char *telemetry_name;
+
+static uint64_t realtime_ns(){
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Map the stats block named by PJACOBI_TELEMETRY, or a private one.
+ * Monitoring is optional, so if the named one can't be had (no /dev/shm
+ * in a container, say) the solve goes ahead with a private block.
+ */
+void telemetry_open(double target_delta){
+    size_t size = telemetry_size( NUM_THREADS );
+    int fd;
+
+    telemetry = MAP_FAILED;
+    telemetry_name = getenv( TELEMETRY_ENV );
+    if( telemetry_name ){
+        /* Unlink a previous run's block rather than reuse it: readers still
+         * attached to it keep that one, and O_EXCL means this run's starts
+         * out zeroed, magic included, and is the only one it may unlink.
+         */
+        shm_unlink( telemetry_name );
+        fd = shm_open( telemetry_name, O_CREAT | O_EXCL | O_RDWR, 0644 );
+        if( fd != -1 && !ftruncate( fd, size ) ){
+            telemetry = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        }
+        if( telemetry == MAP_FAILED ){
+            fprintf( stderr, "%s: %s; telemetry disabled\n", telemetry_name, strerror( errno ) );
+            if( fd != -1 ){
+                shm_unlink( telemetry_name );
+            }
+            telemetry_name = NULL;
+        }
+        if( fd != -1 ){
+            close( fd );
+        }
+    }
+    if( telemetry == MAP_FAILED ){
+        telemetry = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        assert( telemetry != MAP_FAILED );
+    }
+    telemetry->n = N;
+    telemetry->num_threads = NUM_THREADS;
+    telemetry_store_double( &telemetry->target_delta, target_delta );
+    telemetry->start_ns = realtime_ns();
+    telemetry->version = TELEMETRY_VERSION;
+    // Readers check the magic last.
+    __atomic_store_n( &telemetry->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE );
+}
+
+void telemetry_close(){
+    telemetry_store( &telemetry->done, 1 );
+    if( telemetry_name ){
+        // Readers that already have it mapped keep their view.
+        shm_unlink( telemetry_name );
+    }
+    munmap( telemetry, telemetry_size( NUM_THREADS ) );
+}
+
+// Slope of log delta against log iteration from (c0,d0) to (c1,d1).
+static double eta_slope(uint32_t c0, double d0, uint32_t c1, double d1){
+    return log( d1 / d0 ) / log( (double)c1 / c0 );
+}
+
+/* Thread 0 publishes the iteration, delta and an ETA.  From a cold start
+ * delta falls as a power of the iteration count rather than geometrically
+ * (about count^-1.1 here), so the ETA extends a straight line through log
+ * delta against log count over the second half of the run so far.  It
+ * stays unknown, -1, until the slopes over the third and fourth quarters
+ * agree to within ETA_SPREAD.
+ */
+void telemetry_publish(uint32_t count, double target_delta){
+    // samples[i] is the delta at iteration (i+1)*stride; count starts at 1.
+    static double samples[ETA_SAMPLES];
+    static uint32_t num_samples, stride=1;
+    uint32_t i, h, q;
+    double p, eta = -1.0;
+    uint64_t now = realtime_ns();
+
+    if( num_samples >= 8 && delta > 0.0 ){
+        h = num_samples / 2 - 1;
+        q = 3 * num_samples / 4 - 1;
+        p = eta_slope( (h+1)*stride, samples[h], count, delta );
+        if( samples[h] > 0.0 && samples[q] > 0.0 && p < 0.0 &&
+                fabs( eta_slope( (h+1)*stride, samples[h], (q+1)*stride, samples[q] ) -
+                    eta_slope( (q+1)*stride, samples[q], count, delta ) ) <= ETA_SPREAD * -p ){
+            eta = count * ( pow( target_delta / delta, 1.0 / p ) - 1.0 )   // iterations left
+                * (now - telemetry->start_ns) / 1e9 / count;                // seconds per iteration
+            eta = eta > 0.0 ? eta : 0.0;
+        }
+    }
+    if( count % stride == 0 ){
+        if( num_samples == ETA_SAMPLES ){
+            // Keep every other sample and take half as many from now on.
+            for( i=0; i<ETA_SAMPLES/2; i++ ){
+                samples[i] = samples[2*i + 1];
+            }
+            num_samples = ETA_SAMPLES / 2;
+            stride *= 2;
+        }
+        if( count % stride == 0 ){
+            samples[num_samples++] = delta;
+        }
+    }
+
+    telemetry_store( &telemetry->iteration, count );
+    telemetry_store_double( &telemetry->delta, delta );
+    telemetry_store_double( &telemetry->eta, eta );
+    telemetry_store( &telemetry->update_ns, now );
+}
+
+// Fold one thread's counts into the run totals.
+void perf_merge(struct perfctr *pc, uint64_t counts[NUM_PHASES][PERFCTR_NUM_EVENTS]){
+    uint32_t phase, e;
+
+    pthread_mutex_lock( &perf_mutex );
+    if( pc->nopen && !pc->running ){
+        perf_unscheduled++;
+    }else if( pc->nopen ){
+        perf_threads++;
+        perf_time_enabled += pc->enabled;
+        perf_time_running += pc->running;
+        for( phase=0; phase<NUM_PHASES; phase++ ){
+            for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+                perf_totals[phase][e] += counts[phase][e];
+            }
+        }
+        for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+            perf_events[e] |= pc->fd[e] != -1;
+        }
+    }else{
+        perf_errno = pc->error;
+    }
+    pthread_mutex_unlock( &perf_mutex );
+}
+
+// Goes to stderr so that the usual timing line on stdout is unchanged.
+void perf_report(){
+    uint32_t phase, e;
+
+    fflush( stdout );
+    if( !perf_threads && perf_unscheduled ){
+        fprintf( stderr, "\nperf events opened on %" PRIu64 " threads but never got the PMU\n", perf_unscheduled );
+        return;
+    }
+    if( !perf_threads ){
+        fprintf( stderr, "\nperf events unavailable: %s\n", strerror( perf_errno ) );
+        return;
+    }
+    fprintf( stderr, "\nperf events on %" PRIu64 " of %" PRIu64 " threads", perf_threads, (uint64_t)NUM_THREADS );
+    if( perf_unscheduled ){
+        fprintf( stderr, " (%" PRIu64 " more never got the PMU)", perf_unscheduled );
+    }
+    // Below 100% the kernel multiplexed the groups and the counts are scaled estimates.
+    fprintf( stderr, ", counting %.1lf%% of the time\n%-8s", 100.0 * perf_time_running / perf_time_enabled, "phase" );
+    for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+        fprintf( stderr, " %15s", perfctr_names[e] );
+    }
+    fprintf( stderr, "\n" );
+    for( phase=0; phase<NUM_PHASES; phase++ ){
+        fprintf( stderr, "%-8s", phase_names[phase] );
+        for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+            if( perf_events[e] ){
+                fprintf( stderr, " %15" PRIu64, perf_totals[phase][e] );
+            }else{
+                fprintf( stderr, " %15s", "n/a" );
+            }
+        }
+        fprintf( stderr, "\n" );
+    }
+}
+
 void* thread_loop(void *threadid){
 
     uint64_t t = (uint64_t)(threadid);
-    double target_delta=0.05;
+    double target_delta=TARGET_DELTA;
     uint32_t count=0;
-    struct timeval init_start, init_stop, delta_start, delta_stop, calc_start, calc_stop;
-    double elapsed_delta=0.0, elapsed_calc=0.0;
-
+    struct timeval init_start, init_stop, delta_start, delta_stop, calc_start, calc_stop, wait_start, wait_stop;
+    double elapsed_delta=0.0, elapsed_calc=0.0, elapsed_wait=0.0;
+    struct telemetry_thread *stats = &telemetry->threads[t];
+    struct perfctr pc = { .nopen = 0 };     // perfctr_sample() is a no-op until opened.
+    uint64_t counts[NUM_PHASES][PERFCTR_NUM_EVENTS] = {{0}}, init_counts[PERFCTR_NUM_EVENTS] = {0};
+
+    if( perf_enabled ){
+        perfctr_open( &pc );
+    }
 
     // Initialization (Have thread 0 do this for now as it doesn't take long.)
     if( t == 0 ){
@@ -216,6 +427,7 @@ void* thread_loop(void *threadid){
 
     // Hold up all threads until after thread 0 is done initializing.
     pthread_barrier_wait( &barrier[BARRIER_INIT] );
+    perfctr_sample( &pc, init_counts );
 
     // Combined calculation and stopping condition
     while(1){
@@ -223,17 +435,28 @@ void* thread_loop(void *threadid){
         gettimeofday( &calc_start, NULL );
         calculate_avg(!(count%2),!!(count%2), t);
         gettimeofday( &calc_stop, NULL );
+        perfctr_sample( &pc, counts[PHASE_CALC] );
         elapsed_calc += (calc_stop.tv_sec - calc_start.tv_sec) + (calc_stop.tv_usec - calc_start.tv_usec)/1000000.0;
 
         gettimeofday( &delta_start, NULL );
         if( t==0 ){ // Just have thread 0 do this.
             delta = calculate_delta();
+            telemetry_publish( count, target_delta );
         }
         gettimeofday( &delta_stop, NULL );
+        perfctr_sample( &pc, counts[PHASE_DELTA] );
         elapsed_delta += (delta_stop.tv_sec - delta_start.tv_sec) + (delta_stop.tv_usec - delta_start.tv_usec)/1000000.0;
 
         // Force everyone to wait until thread 0 has written to the global delta variable.
+        gettimeofday( &wait_start, NULL );
         pthread_barrier_wait( &barrier[BARRIER_DELTA] );
+        gettimeofday( &wait_stop, NULL );
+        perfctr_sample( &pc, counts[PHASE_BARRIER] );
+        elapsed_wait += (wait_stop.tv_sec - wait_start.tv_sec) + (wait_stop.tv_usec - wait_start.tv_usec)/1000000.0;
+
+        telemetry_store( &stats->iterations, count );
+        telemetry_store( &stats->calc_ns, elapsed_calc * 1e9 );
+        telemetry_store( &stats->wait_ns, elapsed_wait * 1e9 );
 
         if( delta < target_delta ){
             break;
@@ -244,6 +467,10 @@ void* thread_loop(void *threadid){
         fprintf(stdout, "%lf %lf ", elapsed_delta, elapsed_calc);
         //print_grid(0);
     }
+    if( perf_enabled ){
+        perf_merge( &pc, counts );
+        perfctr_close( &pc );
+    }
     pthread_exit(NULL);
 }
 
@@ -255,6 +482,16 @@ int main(){
     for( t=0; t<NUM_BARRIERS; t++ ){
         assert( ! pthread_barrier_init( &barrier[t], NULL, NUM_THREADS ) );
     }
+    telemetry_open( TARGET_DELTA );
+    perf_enabled = getenv( "PJACOBI_PERF" ) != NULL;
+    if( perf_enabled ){
+        // Each thread's group takes PERFCTR_NUM_EVENTS descriptors, far more than the usual soft limit.
+        struct rlimit rl;
+        if( !getrlimit( RLIMIT_NOFILE, &rl ) && rl.rlim_cur < rl.rlim_max ){
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit( RLIMIT_NOFILE, &rl );
+        }
+    }
 
     for( t=0; t<NUM_THREADS; t++ ){
         assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
@@ -267,6 +504,10 @@ int main(){
     for( t=0; t<NUM_BARRIERS; t++ ){
         assert( ! pthread_barrier_destroy( &barrier[t] ) );
     }
+    telemetry_close();
+    if( perf_enabled ){
+        perf_report();
+    }
     pthread_exit(NULL);
 
 }
@@ -0,0 +1,183 @@
+/* Batch mode: solve many small, independent grids on one worker pool.
+ *
+ * The job file has one job per line:
+ *
+ *      <n> <sink temp> <source temp> <target delta> [output file]
+ *
+ * Blank lines and lines starting with '#' are ignored, and jobs are
+ * reported by the line they came from, so skipped lines leave gaps in
+ * the numbering rather than shifting it.  Each worker in
+ * the pool pulls the next job off a shared queue, solves it to its own
+ * target delta and reports it as soon as it is done.  Jobs are handed
+ * out largest first so that one big grid doesn't end up as the last
+ * thing running on an otherwise idle machine.  The pool and each
+ * worker's pair of grids persist across jobs; a worker only grows its
+ * grids when it picks up a job larger than any it has seen.
+ *
+ * Usage: pjbatch <job file> [threads]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3), qsort(3)
+#include <unistd.h>     // sysconf(3)
+#include <sys/time.h>   // gettimeofday()
+#include "stencil.h"
+
+#define MAX_JOBS (65536)
+#define MAX_PATH (256)
+
+struct job{
+    uint64_t id;        // Line of the job file, counting from 1.
+    uint64_t n;
+    double sink, source, target_delta;
+    char out[MAX_PATH]; // Empty if no output was requested.
+};
+
+static struct job jobs[MAX_JOBS];
+static uint64_t num_jobs;
+static uint64_t next_job;       // Shared queue head; fetch-and-add only.
+static uint64_t total_updates;  // Cell updates across all jobs.
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double now(){
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+static int by_size(const void *a, const void *b){
+    const struct job *ja=a, *jb=b;
+    if( ja->n != jb->n ){
+        return ja->n < jb->n ? 1 : -1;
+    }
+    return ja->id < jb->id ? -1 : 1;
+}
+
+static void read_jobs(const char *path){
+    char line[1024];
+    uint64_t line_number=0;
+    FILE *f = fopen( path, "r" );
+    assert( f );
+    while( fgets( line, sizeof(line), f ) ){
+        struct job *j = &jobs[num_jobs];
+        int fields;
+        line_number++;
+        if( line[0] == '#' || line[0] == '\n' ){
+            continue;
+        }
+        assert( num_jobs < MAX_JOBS );
+        j->out[0] = '\0';
+        fields = sscanf( line, "%" SCNu64 " %lf %lf %lf %255s",
+                &j->n, &j->sink, &j->source, &j->target_delta, j->out );
+        // A target of zero or less would never be reached.
+        if( fields < 4 || j->n < 3 || !( j->target_delta > 0.0 ) ){
+            fprintf( stderr, "Skipping malformed job on line %" PRIu64 ": %s", line_number, line );
+            continue;
+        }
+        j->id = line_number;
+        num_jobs++;
+    }
+    fclose( f );
+    qsort( jobs, num_jobs, sizeof(struct job), by_size );
+}
+
+static void write_grid(const char *path, const double *g, uint64_t n){
+    uint64_t x, y;
+    FILE *f = fopen( path, "w" );
+    if( !f ){
+        fprintf( stderr, "Could not open %s\n", path );
+        return;
+    }
+    for( y=0; y<n; y++ ){
+        for( x=0; x<n; x++ ){
+            fprintf( f, "%05.1lf ", g[y*n + x] );
+        }
+        fprintf( f, "\n" );
+    }
+    fclose( f );
+}
+
+void* thread_loop(void *threadid){
+    double *grid[2] = { NULL, NULL };
+    uint64_t capacity=0;    // Cells allocated per grid.
+    uint64_t idx, count;
+    double delta, start;
+
+    while( (idx = __atomic_fetch_add( &next_job, 1, __ATOMIC_RELAXED )) < num_jobs ){
+        struct job *j = &jobs[idx];
+        uint64_t n = j->n;
+
+        if( n*n > capacity ){
+            capacity = n*n;
+            free( grid[0] );
+            free( grid[1] );
+            grid[0] = malloc( capacity * sizeof(double) );
+            grid[1] = malloc( capacity * sizeof(double) );
+            assert( grid[0] && grid[1] );
+        }
+
+        start = now();
+        stencil_init( grid[0], n, j->sink, j->source );
+        stencil_init( grid[1], n, j->sink, j->source );
+        count = 0;
+        do{
+            count++;
+            delta = stencil_rows( grid[!(count%2)], grid[!!(count%2)], n, 0, n );
+        }while( delta >= j->target_delta );
+
+        // The last sweep wrote grid[count%2].
+        if( j->out[0] ){
+            write_grid( j->out, grid[count%2], n );
+        }
+        __atomic_fetch_add( &total_updates, count*n*n, __ATOMIC_RELAXED );
+
+        pthread_mutex_lock( &report_mutex );
+        fprintf( stdout, "job %" PRIu64 " n %" PRIu64 " iterations %" PRIu64 " delta %lf time %lf\n",
+                j->id, n, count, delta, now() - start );
+        fflush( stdout );
+        pthread_mutex_unlock( &report_mutex );
+    }
+
+    free( grid[0] );
+    free( grid[1] );
+    pthread_exit(NULL);
+}
+
+int main(int argc, char *argv[]){
+    pthread_t *threads;
+    uint64_t t, num_threads;
+    double start, elapsed;
+
+    if( argc < 2 ){
+        fprintf( stderr, "Usage: %s <job file> [threads]\n", argv[0] );
+        return 1;
+    }
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    assert( num_threads > 0 );
+
+    read_jobs( argv[1] );
+    if( num_threads > num_jobs && num_jobs > 0 ){
+        num_threads = num_jobs;
+    }
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+
+    fprintf( stdout, "jobs %" PRIu64 " threads %" PRIu64 " time %lf jobs/s %lf updates/s %le\n",
+            num_jobs, num_threads, elapsed, num_jobs / elapsed, total_updates / elapsed );
+    free( threads );
+    return 0;
+}
@@ -0,0 +1,204 @@
+/* Chebyshev-accelerated version of pjacobi.
+ *
+ * One Jacobi sweep is u' = G u, where G is the averaging in
+ * calculate_avg() with the source and sink held fixed.  G is similar to
+ * a symmetric matrix, so its eigenvalues are real, and for this 3x3 mean
+ * they lie in [ALPHA, beta] with beta just below 1.  Jacobi shrinks the
+ * error by about beta per sweep; Chebyshev semi-iteration combines the
+ * last two iterates with the sweep so that after k steps the error is
+ * scaled by a Chebyshev polynomial that is small over the whole interval:
+ *
+ *      y       = G u_k                         (the normal sweep)
+ *      u_{k+1} = w_{k+1} (g y + (1-g) u_k - u_{k-1}) + u_{k-1}
+ *
+ * where g = 2 / (2 - beta - ALPHA) maps the interval onto [-s,s],
+ * s = (beta - ALPHA) / (2 - beta - ALPHA), and w_1 = 1,
+ * w_2 = 1 / (1 - s^2/2), w_{k+1} = 1 / (1 - s^2 w_k / 4).
+ * Fixed cells are equal in y, u_k and u_{k-1} and so stay fixed.
+ *
+ * beta is estimated from the decay of delta over WARMUP plain sweeps.
+ * The stopping criterion is unchanged: stop at the first iterate whose
+ * Jacobi update max|G u_k - u_k| is below target_delta.  Plain Jacobi is
+ * run first on the same problem for comparison.
+ *
+ * Usage: pjcheby [n] [threads] [target delta]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+
+#define ALPHA (-1.0/3.0)    // Lower bound on the eigenvalues of G.
+#define WARMUP (32ULL)      // Plain sweeps used to estimate beta.
+#define MAX_ITERS (10000000ULL)
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads;
+static double *grid[3];
+static struct partial *partials;
+static pthread_barrier_t barrier;
+static double target_delta=0.05;
+static int accelerate;
+
+// Written only by the barrier's serial thread.
+static double delta, first_delta, beta, sigma, gamma_, omega;
+static uint64_t count;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+// Runs on the barrier's serial thread after every sweep.
+static void next_step(){
+    uint64_t w;
+
+    delta = 0.0;
+    for( w=0; w<num_threads; w++ ){
+        delta = partials[w].delta > delta ? partials[w].delta : delta;
+    }
+    count++;
+    if( !accelerate ){
+        return;
+    }
+    if( count == WARMUP/2 ){
+        first_delta = delta;
+    }else if( count == WARMUP ){
+        // Jacobi's error, and so delta, shrinks by about beta per sweep.
+        beta = pow( delta / first_delta, 1.0 / (WARMUP - WARMUP/2) );
+        beta = beta < 1.0 ? beta : 1.0 - 1e-9;
+        gamma_ = 2.0 / (2.0 - beta - ALPHA);
+        sigma = (beta - ALPHA) / (2.0 - beta - ALPHA);
+        omega = 1.0;
+    }else if( count > WARMUP ){
+        omega = omega == 1.0 ? 1.0 / (1.0 - sigma*sigma/2.0) : 1.0 / (1.0 - sigma*sigma*omega/4.0);
+    }
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t x, y;
+    double d, g, w, max_delta;
+    double *prev, *cur, *next;
+
+    while(1){
+        prev = grid[(count+2)%3];
+        cur  = grid[ count   %3];
+        next = grid[(count+1)%3];
+        if( !accelerate || count < WARMUP ){
+            max_delta = stencil_rows( cur, next, n, lo, hi );
+        }else{
+            g = gamma_;
+            w = omega;
+            max_delta = 0.0;
+            for( y=lo; y<hi; y++ ){
+                double *out = &next[y*n];
+                const double *c = &cur[y*n], *p = &prev[y*n];
+                d = stencil_row( y>0   ? &cur[(y-1)*n] : NULL, c,
+                                 y<n-1 ? &cur[(y+1)*n] : NULL,
+                                 out, n, stencil_fixed(n, y) );
+                max_delta = d > max_delta ? d : max_delta;
+                for( x=0; x<n; x++ ){
+                    out[x] = w * ( g*out[x] + (1.0-g)*c[x] - p[x] ) + p[x];
+                }
+            }
+        }
+        partials[t].delta = max_delta;
+
+        if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            next_step();
+        }
+        pthread_barrier_wait( &barrier );
+        // delta is the Jacobi update of the iterate we just read.
+        if( delta < target_delta || count >= MAX_ITERS ){
+            break;
+        }
+    }
+    pthread_exit(NULL);
+}
+
+// Solve and return the converged iterate.
+static double* solve(int accel){
+    pthread_t *threads;
+    uint64_t t;
+    double start, elapsed;
+
+    accelerate = accel;
+    count = 0;
+    for( t=0; t<3; t++ ){
+        stencil_init( grid[t], n, SINK_TEMP, SOURCE_TEMP );
+    }
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+    free( threads );
+
+    fprintf( stdout, "%-9s iterations %" PRIu64 " delta %lf time %lf", accel ? "chebyshev" : "jacobi", count, delta, elapsed );
+    if( accel ){
+        fprintf( stdout, " beta %lf", beta );
+    }
+    fprintf( stdout, "\n" );
+    // The sweep that met the criterion read grid[(count-1)%3].
+    return grid[(count-1)%3];
+}
+
+int main(int argc, char *argv[]){
+    double *jacobi, *cheby, diff=0.0;
+    uint64_t i, jacobi_count;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    target_delta = argc > 3 ? strtod( argv[3], NULL ) : target_delta;
+    assert( n >= 3 && num_threads > 0 && target_delta > 0.0 );
+
+    for( i=0; i<3; i++ ){
+        grid[i] = malloc( n * n * sizeof(double) );
+        assert( grid[i] );
+    }
+    jacobi = malloc( n * n * sizeof(double) );
+    assert( jacobi );
+    assert( ! posix_memalign( (void**)&partials, 64, num_threads * sizeof(struct partial) ) );
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " target %lf\n", n, num_threads, target_delta );
+    cheby = solve( 0 );
+    jacobi_count = count;
+    for( i=0; i<n*n; i++ ){
+        jacobi[i] = cheby[i];
+    }
+    cheby = solve( 1 );
+    for( i=0; i<n*n; i++ ){
+        diff = fabs( jacobi[i] - cheby[i] ) > diff ? fabs( jacobi[i] - cheby[i] ) : diff;
+    }
+    fprintf( stdout, "iterations saved %.1lf%% max difference %lf\n",
+            100.0 * ( 1.0 - (double)count / jacobi_count ), diff );
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    free( partials );
+    free( jacobi );
+    for( i=0; i<3; i++ ){
+        free( grid[i] );
+    }
+    return 0;
+}
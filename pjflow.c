@@ -0,0 +1,204 @@
+/* Barrier-free version of pjacobi.
+ *
+ * Each worker owns a block of rows.  Producing generation k+1 of a block
+ * only needs generation k of the block itself and of the row directly
+ * above and below it, so instead of a global barrier a worker waits for
+ * its two neighbours' published generation counters to reach k.  The
+ * counters are written with release and read with acquire semantics,
+ * which also makes the neighbours' rows visible.  Neighbours can drift
+ * one generation apart, so workers at opposite ends of the grid can be
+ * up to (threads-1) generations apart.
+ *
+ * Convergence is aggregated asynchronously.  Every worker folds its
+ * block's max change for generation k into a slot for that generation;
+ * the last worker to arrive decides whether generation k has converged,
+ * and the first such decision sets stop_gen.  Nobody waits for decisions,
+ * so by then other workers may have overwritten generation stop_gen with
+ * later ones.  Instead every worker runs on to generation
+ * stop_gen + threads-1 and stops there.  None can get further without
+ * seeing stop_gen: computing generation k+1 means waiting for neighbours
+ * at k, who waited for theirs at k-1, and so on, so a worker at
+ * stop_gen + threads-1 has (through acquire loads) waited for every
+ * worker to finish stop_gen + 1, including the one that set stop_gen
+ * before doing so.  The result is that later generation, which is
+ * reported along with its delta and the generation that converged first.
+ * With one thread the two are the same, as with the barrier version.
+ *
+ * Usage: pjflow [n] [threads]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>      // sched_yield()
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcpy(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+
+#define SPINS_BEFORE_YIELD (1024)
+
+// One per worker, and one per in-flight generation.  Padded so that
+// workers spinning on a neighbour don't share its line with anyone else.
+struct counter{
+    _Atomic uint64_t value;
+} __attribute__((aligned(64)));
+
+struct slot{
+    _Atomic uint64_t arrived;   // Workers that have reported this generation.
+    _Atomic uint64_t max_bits;  // Max change so far, as the bits of a double.
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads, num_slots;
+static double *grid[2];
+static struct counter *generation;  // Generations completed by each worker.
+static struct slot *slots;          // Indexed by generation % num_slots.
+static _Atomic uint64_t stop_gen = UINT64_MAX;    // First generation found to have converged.
+static double final_delta;          // Of generation stop_gen + num_threads-1.
+static double target_delta=0.05;
+static _Atomic uint64_t spins;      // Times a worker had to wait, all workers.
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+/* Spin until the counter reaches want.  Every worker runs to the same
+ * last generation, so whatever we wait for will come.
+ */
+static void wait_for(_Atomic uint64_t *counter, uint64_t want){
+    uint64_t i=0;
+    while( atomic_load_explicit( counter, memory_order_acquire ) < want ){
+        if( ++i % SPINS_BEFORE_YIELD == 0 ){
+            sched_yield();
+        }
+    }
+    if( i ){
+        atomic_fetch_add_explicit( &spins, 1, memory_order_relaxed );
+    }
+}
+
+// Fold a block's max change into generation gen.
+static void report(uint64_t gen, double block_delta){
+    struct slot *s = &slots[gen % num_slots];
+    uint64_t bits, old;
+
+    // Non-negative doubles order the same way as their bit patterns.
+    memcpy( &bits, &block_delta, sizeof(bits) );
+    old = atomic_load_explicit( &s->max_bits, memory_order_relaxed );
+    while( bits > old &&
+            ! atomic_compare_exchange_weak_explicit( &s->max_bits, &old, bits,
+                memory_order_relaxed, memory_order_relaxed ) ){
+    }
+
+    if( atomic_fetch_add_explicit( &s->arrived, 1, memory_order_acq_rel ) == num_threads-1 ){
+        double max_delta;
+        bits = atomic_load_explicit( &s->max_bits, memory_order_relaxed );
+        memcpy( &max_delta, &bits, sizeof(max_delta) );
+        old = UINT64_MAX;
+        if( max_delta < target_delta ){
+            // Only the first decision counts, so every worker agrees on where to stop.
+            atomic_compare_exchange_strong_explicit( &stop_gen, &old, gen,
+                    memory_order_relaxed, memory_order_relaxed );
+        }
+        // Every report of gen, including the one from whoever set stop_gen, came before ours.
+        old = atomic_load_explicit( &stop_gen, memory_order_relaxed );
+        if( old != UINT64_MAX && gen == old + num_threads-1 ){
+            final_delta = max_delta;
+        }
+        /* Nobody reaches generation gen+num_slots without waiting, through
+         * the neighbour counters, for us to publish generation gen+1 after
+         * this.
+         */
+        atomic_store_explicit( &s->arrived, 0, memory_order_relaxed );
+        atomic_store_explicit( &s->max_bits, 0, memory_order_relaxed );
+    }
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t k;     // Generations this worker has completed.
+    uint64_t stop;
+    double d;
+
+    for( k=0; ; k++ ){
+        if( t > 0 ){
+            wait_for( &generation[t-1].value, k );
+        }
+        if( t < num_threads-1 ){
+            wait_for( &generation[t+1].value, k );
+        }
+        // After the waits, so that it is seen by the time k is the last generation.
+        stop = atomic_load_explicit( &stop_gen, memory_order_relaxed );
+        if( stop != UINT64_MAX && k >= stop + num_threads-1 ){
+            break;
+        }
+
+        d = stencil_rows( grid[k%2], grid[(k+1)%2], n, lo, hi );
+        atomic_store_explicit( &generation[t].value, k+1, memory_order_release );
+        report( k+1, d );
+    }
+    pthread_exit(NULL);
+}
+
+int main(int argc, char *argv[]){
+    pthread_t *threads;
+    uint64_t t, count;
+    double start, elapsed, checksum=0.0;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    assert( n >= 3 && num_threads > 0 && num_threads <= n );
+    // Workers are at most num_threads-1 generations apart, so at most num_threads are being reported at once.
+    num_slots = num_threads + 1;
+
+    grid[0] = malloc( n * n * sizeof(double) );
+    grid[1] = malloc( n * n * sizeof(double) );
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( grid[0] && grid[1] && threads );
+    assert( ! posix_memalign( (void**)&generation, 64, num_threads * sizeof(struct counter) ) );
+    assert( ! posix_memalign( (void**)&slots, 64, num_slots * sizeof(struct slot) ) );
+    for( t=0; t<num_threads; t++ ){
+        atomic_init( &generation[t].value, 0 );
+    }
+    for( t=0; t<num_slots; t++ ){
+        atomic_init( &slots[t].arrived, 0 );
+        atomic_init( &slots[t].max_bits, 0 );
+    }
+    stencil_init( grid[0], n, SINK_TEMP, SOURCE_TEMP );
+    stencil_init( grid[1], n, SINK_TEMP, SOURCE_TEMP );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+
+    // Every worker stopped after the same generation, which lives in grid[count%2].
+    count = atomic_load( &stop_gen ) + num_threads-1;
+    for( t=0; t<n*n; t++ ){
+        checksum += fabs( grid[count%2][t] );
+    }
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " converged %" PRIu64 " iterations %" PRIu64
+            " delta %lf time %lf waits %" PRIu64 " checksum %.12le\n",
+            n, num_threads, (uint64_t)atomic_load( &stop_gen ), count, final_delta, elapsed,
+            (uint64_t)atomic_load( &spins ), checksum );
+
+    free( slots );
+    free( generation );
+    free( threads );
+    free( grid[0] );
+    free( grid[1] );
+    return 0;
+}
@@ -0,0 +1,196 @@
+/* Single-grid version of pjacobi.
+ *
+ * NUMGRIDS = 2 keeps a whole second grid around although updating row y
+ * only needs the old values of rows y-1, y and y+1.  Here each worker
+ * updates its block of rows in place, keeping a rolling buffer of two
+ * old rows: before row y is overwritten it is copied aside, so the old
+ * row y-1 and row y are in the buffer and the old row y+1 is still in the
+ * grid.
+ *
+ * Rows just outside the block belong to a neighbour, which is updating
+ * them at the same time.  So at the end of each iteration every worker
+ * also saves its first and last row into a halo buffer, double buffered
+ * by iteration parity, and its neighbours read those during the next
+ * iteration.  The results are bitwise identical to the two-grid solver,
+ * which is run first for comparison.
+ *
+ * Memory is one n x n grid plus 6 rows per worker, instead of two grids.
+ *
+ * Usage: pjinplace [n] [threads]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcpy(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+
+enum{
+    HALO_TOP            =0,     // First row of the block.
+    HALO_BOTTOM         =1,     // Last row of the block.
+    NUM_HALOS           =2
+};
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads;
+static double *grid[2];         // grid[1] is only used by the two-grid solver.
+static double *halo;            // [parity][worker][NUM_HALOS][n]
+static struct partial *partials;
+static pthread_barrier_t barrier;
+static double target_delta=0.05;
+static int in_place;
+
+// Written only by the barrier's serial thread.
+static double delta;
+static uint64_t count;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+static double* halo_row(uint64_t parity, uint64_t w, uint32_t which){
+    return &halo[ ( ( parity * num_threads + w ) * NUM_HALOS + which ) * n ];
+}
+
+static void save_halos(uint64_t parity, uint64_t t, uint64_t lo, uint64_t hi){
+    memcpy( halo_row( parity, t, HALO_TOP ), &grid[0][lo*n], n * sizeof(double) );
+    memcpy( halo_row( parity, t, HALO_BOTTOM ), &grid[0][(hi-1)*n], n * sizeof(double) );
+}
+
+// Update rows [lo,hi) of grid[0] in place, reading neighbours from halo[parity].
+static double sweep_in_place(uint64_t parity, uint64_t t, uint64_t lo, uint64_t hi, double *old[2]){
+    const double *up, *down;
+    double *g = grid[0], *tmp, d, max_delta=0.0;
+    uint64_t y;
+
+    for( y=lo; y<hi; y++ ){
+        if( y == lo ){
+            up = y > 0 ? halo_row( parity, t-1, HALO_BOTTOM ) : NULL;
+        }else{
+            up = old[0];
+        }
+        if( y == hi-1 ){
+            down = y < n-1 ? halo_row( parity, t+1, HALO_TOP ) : NULL;
+        }else{
+            down = &g[(y+1)*n];
+        }
+        memcpy( old[1], &g[y*n], n * sizeof(double) );
+        d = stencil_row( up, old[1], down, &g[y*n], n, stencil_fixed(n, y) );
+        max_delta = d > max_delta ? d : max_delta;
+
+        // Old row y becomes the old row above y+1.
+        tmp = old[0];
+        old[0] = old[1];
+        old[1] = tmp;
+    }
+    return max_delta;
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t w, k;
+    double *rows = malloc( 2 * n * sizeof(double) );
+    double *old[2] = { rows, rows + n };    // Swapped row by row.
+
+    assert( rows );
+
+    if( in_place ){
+        save_halos( 0, t, lo, hi );
+        pthread_barrier_wait( &barrier );
+    }
+    for( k=0; ; k++ ){
+        if( in_place ){
+            partials[t].delta = sweep_in_place( k%2, t, lo, hi, old );
+            save_halos( (k+1)%2, t, lo, hi );
+        }else{
+            partials[t].delta = stencil_rows( grid[k%2], grid[(k+1)%2], n, lo, hi );
+        }
+        if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            delta = 0.0;
+            for( w=0; w<num_threads; w++ ){
+                delta = partials[w].delta > delta ? partials[w].delta : delta;
+            }
+            count = k+1;
+        }
+        pthread_barrier_wait( &barrier );
+        if( delta < target_delta ){
+            break;
+        }
+    }
+    free( rows );
+    pthread_exit(NULL);
+}
+
+static double* solve(int place){
+    pthread_t *threads;
+    uint64_t t, bytes;
+    double start, elapsed;
+
+    in_place = place;
+    stencil_init( grid[0], n, SINK_TEMP, SOURCE_TEMP );
+    if( !in_place ){
+        stencil_init( grid[1], n, SINK_TEMP, SOURCE_TEMP );
+    }
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+    free( threads );
+
+    // Grids, plus the rolling rows and halos for the in-place solver.
+    bytes = in_place ? ( n*n + 6*n*num_threads ) * sizeof(double) : 2*n*n * sizeof(double);
+    fprintf( stdout, "%-9s iterations %" PRIu64 " delta %lf time %lf memory %.1lf MB\n",
+            in_place ? "in-place" : "two-grid", count, delta, elapsed, bytes / 1048576.0 );
+    return in_place ? grid[0] : grid[count%2];
+}
+
+int main(int argc, char *argv[]){
+    double *two_grid;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    assert( n >= 3 && num_threads > 0 );
+    num_threads = num_threads < n ? num_threads : n;
+
+    grid[0] = malloc( n * n * sizeof(double) );
+    grid[1] = malloc( n * n * sizeof(double) );
+    two_grid = malloc( n * n * sizeof(double) );
+    halo = malloc( 2 * num_threads * NUM_HALOS * n * sizeof(double) );
+    assert( grid[0] && grid[1] && two_grid && halo );
+    assert( ! posix_memalign( (void**)&partials, 64, num_threads * sizeof(struct partial) ) );
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 "\n", n, num_threads );
+    memcpy( two_grid, solve( 0 ), n * n * sizeof(double) );
+    // The second grid isn't needed from here on.
+    free( grid[1] );
+    grid[1] = NULL;
+    fprintf( stdout, "results %s\n", memcmp( two_grid, solve( 1 ), n * n * sizeof(double) ) ? "differ" : "match" );
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    free( partials );
+    free( halo );
+    free( two_grid );
+    free( grid[0] );
+    return 0;
+}
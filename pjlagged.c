@@ -0,0 +1,152 @@
+/* Lagged convergence check for pjacobi.
+ *
+ * Every worker sweeps a block of rows and computes its block's max change
+ * as part of the sweep.  In the eager version all workers then meet at a
+ * barrier, one of them reduces the per-block maxima and everyone waits at
+ * a second barrier to learn the verdict before starting the next sweep.
+ *
+ * In the lagged version the per-block maxima are double buffered by
+ * generation parity.  After the barrier that ends generation k, workers
+ * start sweeping generation k+1 straight away and only reduce the
+ * maxima for generation k once their own part of k+1 is done, while the
+ * slower workers are still finishing theirs.  Termination is therefore
+ * decided one generation late, but generation k+1 is written to the other
+ * grid, so the converged generation k is still intact and is the result.
+ * That leaves one barrier per iteration and no reduction on the critical
+ * path, at the cost of one extra sweep at the very end.
+ *
+ * Both versions are run on the same problem and their results compared.
+ *
+ * Usage: pjlagged [n] [threads]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcmp(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads;
+static double *grid[2];
+static struct partial *partials[2];     // Per-block max change, by generation parity.
+static pthread_barrier_t barrier;
+static double target_delta=0.05;
+static int lagged;
+
+// Set once the run has converged; every thread computes the same value.
+static double delta;
+static uint64_t count;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+static double reduce(uint32_t parity){
+    uint64_t w;
+    double max_delta=0.0;
+    for( w=0; w<num_threads; w++ ){
+        max_delta = partials[parity][w].delta > max_delta ? partials[parity][w].delta : max_delta;
+    }
+    return max_delta;
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t k;     // Generation being read; k+1 is being written.
+    double d;
+
+    for( k=0; ; k++ ){
+        partials[(k+1)%2][t].delta = stencil_rows( grid[k%2], grid[(k+1)%2], n, lo, hi );
+
+        if( lagged ){
+            // Generation k's maxima were all published before the last barrier.
+            if( k >= 1 && (d = reduce( k%2 )) < target_delta ){
+                if( t==0 ){
+                    delta = d;
+                    count = k;
+                }
+                break;
+            }
+            pthread_barrier_wait( &barrier );
+        }else{
+            if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+                delta = reduce( (k+1)%2 );
+                count = k+1;
+            }
+            pthread_barrier_wait( &barrier );
+            if( delta < target_delta ){
+                break;
+            }
+        }
+    }
+    pthread_exit(NULL);
+}
+
+// Solve and return the grid holding the converged generation.
+static double* solve(int lag){
+    pthread_t *threads;
+    uint64_t t;
+    double start, elapsed;
+
+    lagged = lag;
+    stencil_init( grid[0], n, SINK_TEMP, SOURCE_TEMP );
+    stencil_init( grid[1], n, SINK_TEMP, SOURCE_TEMP );
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+    free( threads );
+
+    fprintf( stdout, "%-6s iterations %" PRIu64 " sweeps %" PRIu64 " delta %lf time %lf\n",
+            lag ? "lagged" : "eager", count, lag ? count+1 : count, delta, elapsed );
+    return grid[count%2];
+}
+
+int main(int argc, char *argv[]){
+    double *eager;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    assert( n >= 3 && num_threads > 0 );
+
+    grid[0] = malloc( n * n * sizeof(double) );
+    grid[1] = malloc( n * n * sizeof(double) );
+    eager = malloc( n * n * sizeof(double) );
+    assert( grid[0] && grid[1] && eager );
+    assert( ! posix_memalign( (void**)&partials[0], 64, num_threads * sizeof(struct partial) ) );
+    assert( ! posix_memalign( (void**)&partials[1], 64, num_threads * sizeof(struct partial) ) );
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 "\n", n, num_threads );
+    memcpy( eager, solve( 0 ), n * n * sizeof(double) );
+    fprintf( stdout, "results %s\n", memcmp( eager, solve( 1 ), n * n * sizeof(double) ) ? "differ" : "match" );
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    free( partials[0] );
+    free( partials[1] );
+    free( eager );
+    free( grid[0] );
+    free( grid[1] );
+    return 0;
+}
@@ -0,0 +1,225 @@
+/* Work-stealing version of pjacobi.
+ *
+ * Instead of one row per thread, each sweep is cut into tiles of
+ * TILE_ROWS rows.  At the start of every iteration worker w is handed
+ * the contiguous range of tiles it would have had under a static split,
+ * so in the common case it touches the same rows as last time.  A worker
+ * takes tiles from the low end of its own range; once that is empty it
+ * steals the upper half of another worker's remaining range, which it
+ * then owns and may in turn be stolen from.
+ *
+ * The same problem is solved twice, first with stealing disabled (the
+ * static split) and then with it enabled, and for each run the
+ * per-iteration imbalance (slowest worker's busy time over the mean) is
+ * reported.
+ *
+ * Usage: pjsteal [n] [threads] [tile rows]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+
+#define TILE_ROWS (8ULL)
+
+struct worker{
+    pthread_spinlock_t lock;
+    uint64_t head, tail;    // Tiles [head,tail) are still to be done.
+    double delta;           // Max change over the tiles this worker did.
+    double busy;            // Seconds spent in this iteration's tiles.
+    uint64_t stolen;        // Tiles taken from other workers, all iterations.
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads, tile_rows, num_tiles;
+static double *grid[2];
+static struct worker *workers;
+static pthread_barrier_t barrier;
+static int stealing;
+static double target_delta=0.05;
+
+// Written only by the barrier's serial thread.
+static double delta;
+static uint64_t count;
+static double imbalance_sum, imbalance_max;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+// Hand every worker its static share of the tiles.
+static void deal_tiles(){
+    uint64_t w;
+    for( w=0; w<num_threads; w++ ){
+        workers[w].head = num_tiles * w / num_threads;
+        workers[w].tail = num_tiles * (w+1) / num_threads;
+        workers[w].delta = 0.0;
+        workers[w].busy = 0.0;
+    }
+}
+
+// Take the next tile from our own range.  Returns 0 if it is empty.
+static int pop_tile(struct worker *me, uint64_t *tile){
+    int found=0;
+    pthread_spin_lock( &me->lock );
+    if( me->head < me->tail ){
+        *tile = me->head++;
+        found = 1;
+    }
+    pthread_spin_unlock( &me->lock );
+    return found;
+}
+
+// Move the upper half of some other worker's range into ours.
+static int steal_tiles(uint64_t self){
+    uint64_t i, v, lo=0, hi=0;
+    for( i=1; i<num_threads && lo==hi; i++ ){
+        struct worker *victim = &workers[(self+i) % num_threads];
+        pthread_spin_lock( &victim->lock );
+        if( victim->head < victim->tail ){
+            v = ( victim->tail - victim->head + 1 ) / 2;
+            hi = victim->tail;
+            lo = victim->tail = hi - v;
+        }
+        pthread_spin_unlock( &victim->lock );
+    }
+    if( lo == hi ){
+        return 0;
+    }
+    pthread_spin_lock( &workers[self].lock );
+    workers[self].head = lo;
+    workers[self].tail = hi;
+    workers[self].stolen += hi - lo;
+    pthread_spin_unlock( &workers[self].lock );
+    return 1;
+}
+
+// Runs on the barrier's serial thread between iterations.
+static void end_iteration(){
+    uint64_t w;
+    double max_busy=0.0, sum_busy=0.0, imbalance;
+
+    delta = 0.0;
+    for( w=0; w<num_threads; w++ ){
+        delta = workers[w].delta > delta ? workers[w].delta : delta;
+        max_busy = workers[w].busy > max_busy ? workers[w].busy : max_busy;
+        sum_busy += workers[w].busy;
+    }
+    imbalance = sum_busy > 0.0 ? max_busy * num_threads / sum_busy - 1.0 : 0.0;
+    imbalance_sum += imbalance;
+    imbalance_max = imbalance > imbalance_max ? imbalance : imbalance_max;
+    count++;
+    deal_tiles();
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    struct worker *me = &workers[t];
+    uint64_t tile, lo, hi;
+    uint32_t base, result;
+    double d, start;
+
+    while(1){
+        // count only changes inside the barrier, so every thread agrees.
+        base = count % 2;
+        result = !base;
+        start = now();
+        while(1){
+            if( ! pop_tile( me, &tile ) ){
+                if( stealing && steal_tiles( t ) ){
+                    continue;
+                }
+                break;
+            }
+            lo = tile * tile_rows;
+            hi = lo + tile_rows < n ? lo + tile_rows : n;
+            d = stencil_rows( grid[base], grid[result], n, lo, hi );
+            me->delta = d > me->delta ? d : me->delta;
+        }
+        me->busy = now() - start;
+
+        if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            end_iteration();
+        }
+        pthread_barrier_wait( &barrier );
+
+        if( delta < target_delta ){
+            break;
+        }
+    }
+    pthread_exit(NULL);
+}
+
+static void solve(int steal){
+    pthread_t *threads;
+    uint64_t t, stolen=0;
+    double start, elapsed;
+
+    stealing = steal;
+    count = 0;
+    imbalance_sum = imbalance_max = 0.0;
+    stencil_init( grid[0], n, SINK_TEMP, SOURCE_TEMP );
+    stencil_init( grid[1], n, SINK_TEMP, SOURCE_TEMP );
+    for( t=0; t<num_threads; t++ ){
+        workers[t].stolen = 0;
+    }
+    deal_tiles();
+
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+        stolen += workers[t].stolen;
+    }
+    elapsed = now() - start;
+    free( threads );
+
+    fprintf( stdout, "%-6s iterations %" PRIu64 " delta %lf time %lf imbalance avg %.1lf%% max %.1lf%% stolen %.1lf tiles/iter\n",
+            steal ? "steal" : "static", count, delta, elapsed,
+            100.0 * imbalance_sum / count, 100.0 * imbalance_max, (double)stolen / count );
+}
+
+int main(int argc, char *argv[]){
+    uint64_t t;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    tile_rows = argc > 3 ? strtoull( argv[3], NULL, 0 ) : TILE_ROWS;
+    assert( n >= 3 && num_threads > 0 && tile_rows > 0 );
+    num_tiles = ( n + tile_rows - 1 ) / tile_rows;
+
+    grid[0] = malloc( n * n * sizeof(double) );
+    grid[1] = malloc( n * n * sizeof(double) );
+    assert( grid[0] && grid[1] );
+    assert( ! posix_memalign( (void**)&workers, 64, num_threads * sizeof(struct worker) ) );
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_spin_init( &workers[t].lock, PTHREAD_PROCESS_PRIVATE ) );
+    }
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " tiles %" PRIu64 " of %" PRIu64 " rows\n",
+            n, num_threads, num_tiles, tile_rows );
+    solve( 0 );
+    solve( 1 );
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    for( t=0; t<num_threads; t++ ){
+        pthread_spin_destroy( &workers[t].lock );
+    }
+    free( workers );
+    free( grid[0] );
+    free( grid[1] );
+    return 0;
+}
@@ -0,0 +1,201 @@
+/* Streaming-store version of pjacobi.
+ *
+ * Every sweep writes all of result_grid without reading it.  With normal
+ * stores each line written is first read in for ownership, so a sweep
+ * moves about 24 bytes per cell update: 8 read from the row below (the
+ * rows above and at y are still cached from the previous row), 8 read for
+ * ownership of the output and 8 written back.  stencil_rows_nt() writes
+ * the output with non-temporal stores, which skip the read for ownership
+ * and bring that down to 16.
+ *
+ * Non-temporal stores also bypass the cache, which is a loss when both
+ * grids fit in the last level cache and the next sweep would have found
+ * its input there.  The auto mode therefore only streams when the two
+ * grids are larger than the LLC.
+ *
+ * The problem is solved with normal stores, with streaming stores and
+ * with the auto choice.  Each run reports two traffic figures:
+ *
+ *      llc-miss    bytes per update measured as 64 bytes per LLC miss,
+ *                  from perfctr.h when the CPU's counters are available.
+ *                  Misses count the reads, including reads for ownership,
+ *                  which is what streaming removes; write-backs aren't
+ *                  counted, so expect about 16 normal and 8 streaming.
+ *      modelled    the 24 or 16 above, and the GB/s that implies.  Only
+ *                  shown when the grids don't fit in the LLC, as
+ *                  otherwise little of that traffic reaches memory.
+ *
+ * Usage: pjstream [n] [threads]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcmp(3), strerror(3)
+#include <unistd.h>     // sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+#include "perfctr.h"
+
+#define DEFAULT_LLC (32ULL*1024*1024)   // If sysconf() doesn't know.
+#define LINE_BYTES  (64)
+
+enum{
+    STORES_NORMAL       =0,
+    STORES_STREAM       =1,
+    STORES_AUTO         =2,
+    NUM_STORES          =3
+};
+static const char *store_names[NUM_STORES] = { "normal", "stream", "auto" };
+static const double bytes_per_update[2] = { 24.0, 16.0 };
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads;
+static double *grid[2];
+static struct partial *partials;
+static pthread_barrier_t barrier;
+static double target_delta=0.05;
+static int streaming;
+
+// Counts from the threads that got counters, for the current solve.
+static uint64_t perf_totals[PERFCTR_NUM_EVENTS];
+static uint64_t perf_threads;
+static int perf_errno;
+static pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Written only by the barrier's serial thread.
+static double delta;
+static uint64_t count;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t w, k, counts[PERFCTR_NUM_EVENTS] = {0};
+    struct perfctr pc;
+    int e;
+
+    perfctr_open( &pc );
+    for( k=0; ; k++ ){
+        if( streaming ){
+            partials[t].delta = stencil_rows_nt( grid[k%2], grid[(k+1)%2], n, lo, hi );
+        }else{
+            partials[t].delta = stencil_rows( grid[k%2], grid[(k+1)%2], n, lo, hi );
+        }
+        if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            delta = 0.0;
+            for( w=0; w<num_threads; w++ ){
+                delta = partials[w].delta > delta ? partials[w].delta : delta;
+            }
+            count = k+1;
+        }
+        pthread_barrier_wait( &barrier );
+        if( delta < target_delta ){
+            break;
+        }
+    }
+    perfctr_sample( &pc, counts );
+
+    pthread_mutex_lock( &perf_mutex );
+    if( pc.nopen && pc.fd[PERFCTR_LLC_MISSES] != -1 ){
+        perf_threads++;
+        for( e=0; e<PERFCTR_NUM_EVENTS; e++ ){
+            perf_totals[e] += counts[e];
+        }
+    }else{
+        perf_errno = pc.nopen ? EOPNOTSUPP : pc.error;     // No LLC miss event.
+    }
+    pthread_mutex_unlock( &perf_mutex );
+    perfctr_close( &pc );
+    pthread_exit(NULL);
+}
+
+static double* solve(int stores, uint64_t llc){
+    pthread_t *threads;
+    uint64_t t, updates;
+    double start, elapsed;
+
+    memset( perf_totals, 0, sizeof(perf_totals) );
+    perf_threads = 0;
+    streaming = stores == STORES_AUTO ? 2 * n * n * sizeof(double) > llc : stores;
+    stencil_init( grid[0], n, SINK_TEMP, SOURCE_TEMP );
+    stencil_init( grid[1], n, SINK_TEMP, SOURCE_TEMP );
+    threads = malloc( num_threads * sizeof(pthread_t) );
+    assert( threads );
+
+    start = now();
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+    elapsed = now() - start;
+    free( threads );
+
+    updates = count * n * n;
+    fprintf( stdout, "%-6s %-6s iterations %" PRIu64 " time %lf updates/s %le",
+            store_names[stores], streaming ? "stream" : "normal", count, elapsed, updates / elapsed );
+    // Only whole runs are comparable, so leave it out unless every thread counted.
+    if( perf_threads == num_threads ){
+        fprintf( stdout, " llc-miss bytes/update %.1lf",
+                (double)perf_totals[PERFCTR_LLC_MISSES] * LINE_BYTES / updates );
+    }else{
+        fprintf( stdout, " llc-miss bytes/update -" );
+    }
+    if( 2 * n * n * sizeof(double) > llc ){
+        fprintf( stdout, " modelled bytes/update %.0lf GB/s %.2lf\n",
+                bytes_per_update[streaming], bytes_per_update[streaming] * updates / elapsed / 1e9 );
+    }else{
+        fprintf( stdout, " modelled bytes/update - (grids fit in llc)\n" );
+    }
+    return grid[count%2];
+}
+
+int main(int argc, char *argv[]){
+    double *normal;
+    long llc;
+
+    n = argc > 1 ? strtoull( argv[1], NULL, 0 ) : 2000;
+    num_threads = argc > 2 ? strtoull( argv[2], NULL, 0 ) : (uint64_t)sysconf( _SC_NPROCESSORS_ONLN );
+    assert( n >= 3 && num_threads > 0 );
+    llc = sysconf( _SC_LEVEL3_CACHE_SIZE );
+    llc = llc > 0 ? llc : DEFAULT_LLC;
+
+    // 64-byte aligned so that most rows start on a line for the streaming stores.
+    assert( ! posix_memalign( (void**)&grid[0], 64, n * n * sizeof(double) ) );
+    assert( ! posix_memalign( (void**)&grid[1], 64, n * n * sizeof(double) ) );
+    assert( ! posix_memalign( (void**)&partials, 64, num_threads * sizeof(struct partial) ) );
+    normal = malloc( n * n * sizeof(double) );
+    assert( normal );
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " grids %" PRIu64 " MB llc %ld MB\n",
+            n, num_threads, 2 * n * n * sizeof(double) >> 20, llc >> 20 );
+    memcpy( normal, solve( STORES_NORMAL, llc ), n * n * sizeof(double) );
+    fprintf( stdout, "results %s\n", memcmp( normal, solve( STORES_STREAM, llc ), n * n * sizeof(double) ) ? "differ" : "match" );
+    solve( STORES_AUTO, llc );
+    if( perf_errno ){
+        fprintf( stderr, "llc misses unavailable: %s\n", strerror( perf_errno ) );
+    }
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    free( normal );
+    free( partials );
+    free( grid[0] );
+    free( grid[1] );
+    return 0;
+}
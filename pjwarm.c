@@ -0,0 +1,232 @@
+/* Warm-started version of pjacobi.
+ *
+ * Rather than starting from all zeros, the initial grid can be
+ *
+ *      -i file     a grid saved by an earlier run with -o, bilinearly
+ *                  interpolated if it is a different size (for example
+ *                  the N/2 or N/4 solution of the same problem)
+ *      -l levels   nested iteration: solve at n/2^levels, interpolate
+ *                  that to twice the size and solve again, and so on up
+ *                  to n
+ *
+ * The heat source and sink are put back at their fixed temperatures
+ * after interpolation.  Every level uses the same stopping criterion.
+ * Work is reported in fine-grid sweeps, so a sweep at n/2 counts as a
+ * quarter; -c also solves from zeros for comparison.
+ *
+ * Saved grids are in the format gridfile.h describes.
+ *
+ * Usage: pjwarm [-n n] [-t threads] [-d target delta] [-i file] [-o file] [-l levels] [-c]
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>     // uint32_t and friends
+#include <inttypes.h>   // PRIu32 and friends
+#include <stdio.h>      // printf and friends
+#include <stdlib.h>     // malloc(3)
+#include <string.h>     // memcpy(3)
+#include <unistd.h>     // getopt(3), sysconf(3)
+#include <time.h>       // clock_gettime()
+#include "stencil.h"
+#include "gridfile.h"
+
+struct partial{
+    double delta;
+} __attribute__((aligned(64)));
+
+static uint64_t n, num_threads;
+static double *grid[2];
+static struct partial *partials;
+static pthread_barrier_t barrier;
+static double target_delta=0.05;
+
+// Written only by the barrier's serial thread.
+static double delta;
+static uint64_t count;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec/1000000000.0;
+}
+
+void* thread_loop(void *threadid){
+    uint64_t t = (uint64_t)(threadid);
+    uint64_t lo = n * t / num_threads;
+    uint64_t hi = n * (t+1) / num_threads;
+    uint64_t w, k;
+
+    for( k=0; ; k++ ){
+        partials[t].delta = stencil_rows( grid[k%2], grid[(k+1)%2], n, lo, hi );
+        if( pthread_barrier_wait( &barrier ) == PTHREAD_BARRIER_SERIAL_THREAD ){
+            delta = 0.0;
+            for( w=0; w<num_threads; w++ ){
+                delta = partials[w].delta > delta ? partials[w].delta : delta;
+            }
+            count = k+1;
+        }
+        pthread_barrier_wait( &barrier );
+        if( delta < target_delta ){
+            break;
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/* Solve the size-n problem starting from grid[0] and return the grid
+ * holding the result.  grid[] must have room for n*n doubles.
+ */
+static double* solve(uint64_t size){
+    pthread_t threads[num_threads];
+    uint64_t t, threads_used = num_threads;
+
+    n = size;
+    // Every thread needs at least one row.
+    num_threads = num_threads < n ? num_threads : n;
+    memcpy( grid[1], grid[0], n * n * sizeof(double) );
+    // realloc(3) wouldn't keep the partials on their own cache lines.
+    free( partials );
+    assert( ! posix_memalign( (void**)&partials, 64, num_threads * sizeof(struct partial) ) );
+    assert( ! pthread_barrier_init( &barrier, NULL, num_threads ) );
+
+    for( t=0; t<num_threads; t++ ){
+        assert( ! pthread_create(&threads[t], NULL, thread_loop, (void*)t ) );
+    }
+    for( t=0; t<num_threads; t++ ){
+        pthread_join( threads[t], NULL );
+    }
+
+    assert( ! pthread_barrier_destroy( &barrier ) );
+    num_threads = threads_used;
+    return grid[count%2];
+}
+
+// Bilinearly interpolate the m x m grid src onto the n x n grid dst.
+static void interpolate(const double *src, uint64_t m, double *dst, uint64_t size){
+    uint64_t x, y, ix, iy;
+    double fx, fy, wx, wy, scale = (double)(m-1) / (size-1);
+
+    for( y=0; y<size; y++ ){
+        fy = y * scale;
+        iy = (uint64_t)fy < m-1 ? (uint64_t)fy : m-2;
+        wy = fy - iy;
+        for( x=0; x<size; x++ ){
+            fx = x * scale;
+            ix = (uint64_t)fx < m-1 ? (uint64_t)fx : m-2;
+            wx = fx - ix;
+            dst[y*size + x] =
+                (1.0-wy) * ( (1.0-wx) * src[ iy   *m + ix] + wx * src[ iy   *m + ix+1] ) +
+                     wy  * ( (1.0-wx) * src[(iy+1)*m + ix] + wx * src[(iy+1)*m + ix+1] );
+        }
+    }
+    dst[0] = SINK_TEMP;
+    dst[size*size-1] = SOURCE_TEMP;
+}
+
+static void save_grid(const char *path, const double *g, uint64_t size){
+    struct grid_header h = { GRID_MAGIC, size };
+    FILE *f = fopen( path, "wb" );
+    assert( f );
+    assert( fwrite( &h, sizeof(h), 1, f ) == 1 );
+    assert( fwrite( g, sizeof(double), size*size, f ) == size*size );
+    fclose( f );
+}
+
+// Returns a malloc'd grid and sets *size, or NULL if the file is bad.
+static double* load_grid(const char *path, uint64_t *size){
+    struct grid_header h;
+    double *g;
+    FILE *f = fopen( path, "rb" );
+
+    if( !f ){
+        return NULL;
+    }
+    if( fread( &h, sizeof(h), 1, f ) != 1 || !grid_header_ok( &h ) ){
+        fclose( f );
+        return NULL;
+    }
+    g = malloc( h.n * h.n * sizeof(double) );
+    assert( g );
+    if( fread( g, sizeof(double), h.n * h.n, f ) != h.n * h.n ){
+        free( g );
+        g = NULL;
+    }
+    fclose( f );
+    *size = h.n;
+    return g;
+}
+
+int main(int argc, char *argv[]){
+    uint64_t size=2000, levels=0, level, m=0, total=0;
+    const char *in=NULL, *out=NULL;
+    int opt, cold=0;
+    double *result, *init=NULL, work=0.0, start;
+
+    num_threads = sysconf( _SC_NPROCESSORS_ONLN );
+    while( (opt = getopt( argc, argv, "n:t:d:i:o:l:c" )) != -1 ){
+        switch( opt ){
+        case 'n': size = strtoull( optarg, NULL, 0 );           break;
+        case 't': num_threads = strtoull( optarg, NULL, 0 );    break;
+        case 'd': target_delta = strtod( optarg, NULL );        break;
+        case 'i': in = optarg;                                  break;
+        case 'o': out = optarg;                                 break;
+        case 'l': levels = strtoull( optarg, NULL, 0 );         break;
+        case 'c': cold = 1;                                     break;
+        default:
+            fprintf( stderr, "Usage: %s [-n n] [-t threads] [-d target delta] [-i file] [-o file] [-l levels] [-c]\n", argv[0] );
+            return 1;
+        }
+    }
+    assert( size >= 3 && num_threads > 0 && target_delta > 0.0 );
+    assert( (size >> levels) >= 3 );
+
+    if( in && !(init = load_grid( in, &m )) ){
+        fprintf( stderr, "%s: not a grid file\n", in );
+        return 1;
+    }
+    grid[0] = malloc( size * size * sizeof(double) );
+    grid[1] = malloc( size * size * sizeof(double) );
+    assert( grid[0] && grid[1] );
+
+    fprintf( stdout, "n %" PRIu64 " threads %" PRIu64 " target %lf\n", size, num_threads, target_delta );
+    if( cold ){
+        stencil_init( grid[0], size, SINK_TEMP, SOURCE_TEMP );
+        start = now();
+        solve( size );
+        fprintf( stdout, "cold   n %5" PRIu64 " iterations %6" PRIu64 " time %lf\n", size, count, now() - start );
+    }
+
+    start = now();
+    for( level=levels+1; level-- > 0; ){
+        uint64_t s = size >> level;
+        if( init ){
+            interpolate( init, m, grid[0], s );
+        }else{
+            stencil_init( grid[0], s, SINK_TEMP, SOURCE_TEMP );
+        }
+        result = solve( s );
+        work += (double)count * s * s / ( size * size );
+        total += count;
+        fprintf( stdout, "level  n %5" PRIu64 " iterations %6" PRIu64 "\n", s, count );
+
+        // The next level starts from this one.
+        free( init );
+        init = malloc( s * s * sizeof(double) );
+        assert( init );
+        memcpy( init, result, s * s * sizeof(double) );
+        m = s;
+    }
+    fprintf( stdout, "warm   n %5" PRIu64 " iterations %6" PRIu64 " fine-grid sweeps %.1lf time %lf\n",
+            size, total, work, now() - start );
+
+    if( out ){
+        save_grid( out, init, size );
+    }
+    free( init );
+    free( partials );
+    free( grid[0] );
+    free( grid[1] );
+    return 0;
+}
@@ -0,0 +1,386 @@
+/* Runtime-sized version of the calculate_avg() stencil used by the
+ * pjacobi variants that take N on the command line.
+ *
+ * Grids are stored row-major (g[y*n + x]) so that the inner x loop is
+ * unit stride.  A cell's new value is the average of itself and each
+ * in-bounds neighbour, which gives the same /9, /6 and /4 cases as
+ * calculate_avg() with the sums taken in the same order, corners
+ * included, so results match pjacobi bit for bit.
+ */
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <math.h>
+#include <stdint.h>     // uint64_t and friends
+#ifdef __SSE2__
+#include <emmintrin.h>  // _mm_stream_pd() and friends
+#endif
+
+#define SINK_TEMP   (-100.0)
+#define SOURCE_TEMP (100.0)
+
+enum{
+    STENCIL_FIX_FIRST   =1,     // out[0] is held constant
+    STENCIL_FIX_LAST    =2      // out[n-1] is held constant
+};
+
+// The heat sink sits at (0,0) and the heat source at (n-1,n-1).
+static inline unsigned stencil_fixed(uint64_t n, uint64_t y){
+    return ( y==0 ? STENCIL_FIX_FIRST : 0 ) | ( y==n-1 ? STENCIL_FIX_LAST : 0 );
+}
+
+/* Compute one output row from the rows above (up), at (mid) and below
+ * (down) it.  up is NULL for the top row and down is NULL for the bottom
+ * row.  Returns the max change in the row, ignoring fixed cells.
+ */
+static inline double stencil_row(const double *up, const double *mid, const double *down,
+        double *out, uint64_t n, unsigned fix){
+    uint64_t x;
+    double v, d, max_delta=0.0;
+
+    if( up && down ){
+        v = fix & STENCIL_FIX_FIRST ? mid[0] : (
+                up[0]   + up[1]   +
+                mid[0]  + mid[1]  +
+                down[0] + down[1] ) / 6.0;
+        out[0] = v;
+        max_delta = fabs( v - mid[0] );
+        for( x=1; x<(n-1); x++ ){
+            v = (
+                up[x-1]   + up[x  ]   + up[x+1]   +
+                mid[x-1]  + mid[x  ]  + mid[x+1]  +
+                down[x-1] + down[x  ] + down[x+1] ) / 9.0;
+            out[x] = v;
+            d = fabs( v - mid[x] );
+            max_delta = d > max_delta ? d : max_delta;
+        }
+        v = fix & STENCIL_FIX_LAST ? mid[n-1] : (
+                up[n-2]   + up[n-1]   +
+                mid[n-2]  + mid[n-1]  +
+                down[n-2] + down[n-1] ) / 6.0;
+    }else{
+        /* Top or bottom row; only one neighbouring row exists.  Like
+         * calculate_avg(), rows are summed top to bottom and the corners
+         * in its own order.
+         */
+        const double *other = up ? up : down;
+        v = fix & STENCIL_FIX_FIRST ? mid[0] : (
+                mid[0]   + other[0] +
+                mid[1]   + other[1] ) / 4.0;
+        out[0] = v;
+        max_delta = fabs( v - mid[0] );
+        if( up ){
+            for( x=1; x<(n-1); x++ ){
+                v = (
+                    up[x-1]  + up[x  ]  + up[x+1]  +
+                    mid[x-1] + mid[x  ] + mid[x+1] ) / 6.0;
+                out[x] = v;
+                d = fabs( v - mid[x] );
+                max_delta = d > max_delta ? d : max_delta;
+            }
+            v = fix & STENCIL_FIX_LAST ? mid[n-1] : (
+                    mid[n-1] + up[n-1] +
+                    mid[n-2] + up[n-2] ) / 4.0;
+        }else{
+            for( x=1; x<(n-1); x++ ){
+                v = (
+                    mid[x-1]  + mid[x  ]  + mid[x+1]  +
+                    down[x-1] + down[x  ] + down[x+1] ) / 6.0;
+                out[x] = v;
+                d = fabs( v - mid[x] );
+                max_delta = d > max_delta ? d : max_delta;
+            }
+            v = fix & STENCIL_FIX_LAST ? mid[n-1] : (
+                    mid[n-1]  + mid[n-2]  +
+                    down[n-1] + down[n-2] ) / 4.0;
+        }
+    }
+    out[n-1] = v;
+    d = fabs( v - mid[n-1] );
+    return d > max_delta ? d : max_delta;
+}
+
+// Zero a grid and set the heat sink and source.
+static inline void stencil_init(double *g, uint64_t n, double sink, double source){
+    uint64_t i;
+    for( i=0; i<n*n; i++ ){
+        g[i] = 0.0;
+    }
+    g[0] = sink;
+    g[n*n-1] = source;
+}
+
+// Sweep rows [lo,hi) of src into dst and return the max change.
+static inline double stencil_rows(const double *src, double *dst, uint64_t n,
+        uint64_t lo, uint64_t hi){
+    uint64_t y;
+    double d, max_delta=0.0;
+    for( y=lo; y<hi; y++ ){
+        d = stencil_row( y>0   ? &src[(y-1)*n] : NULL,
+                                 &src[ y   *n],
+                         y<n-1 ? &src[(y+1)*n] : NULL,
+                         &dst[y*n], n, stencil_fixed(n, y) );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    return max_delta;
+}
+
+/* stencil_row() for callers that know n at compile time; instantiate it
+ * with STENCIL_ROW_SIZED().  With n a constant the compiler can drop the
+ * trip-count checks and peeling from the vectorised loop and unroll it, and
+ * the rows are promised to start on a 64-byte boundary, which holds when
+ * the grid does and n is a multiple of 8.  Results are bitwise identical
+ * to stencil_row().
+ */
+static inline __attribute__((always_inline)) double stencil_row_sized(const double *up,
+        const double *mid, const double *down, double *out, uint64_t n, unsigned fix){
+    uint64_t x;
+    double v, d, max_delta;
+
+    if( !up || !down ){
+        return stencil_row( up, mid, down, out, n, fix );
+    }
+    up = __builtin_assume_aligned( up, 64 );
+    mid = __builtin_assume_aligned( mid, 64 );
+    down = __builtin_assume_aligned( down, 64 );
+    out = __builtin_assume_aligned( out, 64 );
+
+    v = fix & STENCIL_FIX_FIRST ? mid[0] : (
+            up[0]   + up[1]   +
+            mid[0]  + mid[1]  +
+            down[0] + down[1] ) / 6.0;
+    out[0] = v;
+    max_delta = fabs( v - mid[0] );
+#pragma GCC unroll 4
+    for( x=1; x<(n-1); x++ ){
+        v = (
+            up[x-1]   + up[x  ]   + up[x+1]   +
+            mid[x-1]  + mid[x  ]  + mid[x+1]  +
+            down[x-1] + down[x  ] + down[x+1] ) / 9.0;
+        out[x] = v;
+        d = fabs( v - mid[x] );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    v = fix & STENCIL_FIX_LAST ? mid[n-1] : (
+            up[n-2]   + up[n-1]   +
+            mid[n-2]  + mid[n-1]  +
+            down[n-2] + down[n-1] ) / 6.0;
+    out[n-1] = v;
+    d = fabs( v - mid[n-1] );
+    return d > max_delta ? d : max_delta;
+}
+
+/* Define stencil_row_<N>(), with the same signature as stencil_row() so
+ * the two can sit behind one function pointer; its n argument is ignored.
+ */
+#define STENCIL_ROW_SIZED(N)                                                        \
+    static double stencil_row_##N(const double *up, const double *mid,              \
+            const double *down, double *out, uint64_t n, unsigned fix){             \
+        (void)n;                                                                    \
+        return stencil_row_sized( up, mid, down, out, N, fix );                     \
+    }
+
+/* Same as stencil_row() for an interior row, but the output is written
+ * with non-temporal stores and the row below is prefetched ahead of use.
+ * Streaming stores skip the read-for-ownership of out, which would
+ * otherwise be a third of the memory traffic of a sweep; the rows above
+ * and at y were read by the previous row and are still in cache, so only
+ * the row below is worth prefetching.  Results are bitwise identical to
+ * stencil_row().  Callers must _mm_sfence() before other threads read out.
+ */
+#define STENCIL_PREFETCH (64)   // Doubles ahead, 8 cache lines.
+
+static inline double stencil_row_nt(const double *up, const double *mid, const double *down,
+        double *out, uint64_t n, unsigned fix){
+#ifdef __SSE2__
+    uint64_t x;
+    double v, d, max_delta;
+    __m128d vsum, vd, vmax = _mm_setzero_pd();
+    const __m128d ninth = _mm_set1_pd( 9.0 );
+    const __m128d abs_mask = _mm_castsi128_pd( _mm_set1_epi64x( 0x7fffffffffffffffLL ) );
+
+    if( !up || !down ){
+        return stencil_row( up, mid, down, out, n, fix );
+    }
+
+    v = fix & STENCIL_FIX_FIRST ? mid[0] : (
+            up[0]   + up[1]   +
+            mid[0]  + mid[1]  +
+            down[0] + down[1] ) / 6.0;
+    out[0] = v;
+    max_delta = fabs( v - mid[0] );
+
+    // Scalar until out+x is 16-byte aligned for _mm_stream_pd().
+    for( x=1; x<(n-1) && ((uintptr_t)&out[x] & 15); x++ ){
+        v = (
+            up[x-1]   + up[x  ]   + up[x+1]   +
+            mid[x-1]  + mid[x  ]  + mid[x+1]  +
+            down[x-1] + down[x  ] + down[x+1] ) / 9.0;
+        out[x] = v;
+        d = fabs( v - mid[x] );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    for( ; x+2 <= (n-1); x+=2 ){
+        _mm_prefetch( (const char*)&down[x + STENCIL_PREFETCH], _MM_HINT_T0 );
+        // Summed in the same order as stencil_row() so rounding matches.
+        vsum = _mm_loadu_pd( &up[x-1] );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &up[x  ] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &up[x+1] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &mid[x-1] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &mid[x  ] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &mid[x+1] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &down[x-1] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &down[x  ] ) );
+        vsum = _mm_add_pd( vsum, _mm_loadu_pd( &down[x+1] ) );
+        vsum = _mm_div_pd( vsum, ninth );
+        _mm_stream_pd( &out[x], vsum );
+        vd = _mm_and_pd( _mm_sub_pd( vsum, _mm_loadu_pd( &mid[x] ) ), abs_mask );
+        vmax = _mm_max_pd( vmax, vd );
+    }
+    for( ; x<(n-1); x++ ){
+        v = (
+            up[x-1]   + up[x  ]   + up[x+1]   +
+            mid[x-1]  + mid[x  ]  + mid[x+1]  +
+            down[x-1] + down[x  ] + down[x+1] ) / 9.0;
+        out[x] = v;
+        d = fabs( v - mid[x] );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    vmax = _mm_max_pd( vmax, _mm_unpackhi_pd( vmax, vmax ) );
+    d = _mm_cvtsd_f64( vmax );
+    max_delta = d > max_delta ? d : max_delta;
+
+    v = fix & STENCIL_FIX_LAST ? mid[n-1] : (
+            up[n-2]   + up[n-1]   +
+            mid[n-2]  + mid[n-1]  +
+            down[n-2] + down[n-1] ) / 6.0;
+    out[n-1] = v;
+    d = fabs( v - mid[n-1] );
+    return d > max_delta ? d : max_delta;
+#else
+    return stencil_row( up, mid, down, out, n, fix );
+#endif
+}
+
+// stencil_rows() with streaming stores, fenced before returning.
+static inline double stencil_rows_nt(const double *src, double *dst, uint64_t n,
+        uint64_t lo, uint64_t hi){
+    uint64_t y;
+    double d, max_delta=0.0;
+    for( y=lo; y<hi; y++ ){
+        d = stencil_row_nt( y>0   ? &src[(y-1)*n] : NULL,
+                                    &src[ y   *n],
+                            y<n-1 ? &src[(y+1)*n] : NULL,
+                            &dst[y*n], n, stencil_fixed(n, y) );
+        max_delta = d > max_delta ? d : max_delta;
+    }
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+    return max_delta;
+}
+
+
+/* Variable-coefficient version of stencil_row().  Every cell in the
+ * neighbourhood counts in proportion to its weight (its conductivity),
+ * so a cell next to copper follows the copper and one next to an air gap
+ * mostly ignores it.  ku, km and kd are the weight rows matching up, mid
+ * and down, and inv holds each cell's 1 / (sum of the weights in its
+ * neighbourhood) from stencil_weight_norm(), or 0 if there is no weight
+ * there at all, in which case the cell keeps its value.  inv is a double
+ * so the weights of a neighbourhood sum to 1 to within a rounding, and a
+ * constant field stays constant.  Terms are added in stencil_row()'s
+ * order; with all weights 1 the result differs from the plain average
+ * only by multiplying by 1/9 (or 1/6) rather than dividing by 9 (or 6).
+ *
+ * The row macros leave out the outer parentheses so that a sum of them is
+ * added strictly left to right, like stencil_row()'s.
+ */
+#define STENCIL_KR(r, k, a)     ((double)k[a]*r[a])
+#define STENCIL_W2(r, k, a)     STENCIL_KR(r, k, a) + STENCIL_KR(r, k, a+1)
+#define STENCIL_W3(r, k, a)     STENCIL_KR(r, k, a-1) + STENCIL_KR(r, k, a) + STENCIL_KR(r, k, a+1)
+
+// Written as an add rather than a choice between the two so that it
+// compiles to a mask instead of a branch; sum is 0 wherever inv is.
+static inline double stencil_weighted(double sum, double inv, double old){
+    return sum * inv + ( inv > 0.0 ? 0.0 : old );
+}
+
+static inline double stencil_row_weighted(const double *up, const double *mid, const double *down,
+        const float *ku, const float *km, const float *kd, const double *inv,
+        double *out, uint64_t n, unsigned fix){
+    uint64_t x;
+    double v, d, max_delta=0.0;
+
+    if( up && down ){
+        v = fix & STENCIL_FIX_FIRST ? mid[0] : stencil_weighted(
+                STENCIL_W2(up, ku, 0) + STENCIL_W2(mid, km, 0) + STENCIL_W2(down, kd, 0), inv[0], mid[0] );
+        out[0] = v;
+        max_delta = fabs( v - mid[0] );
+        for( x=1; x<(n-1); x++ ){
+            v = stencil_weighted(
+                    STENCIL_W3(up, ku, x) + STENCIL_W3(mid, km, x) + STENCIL_W3(down, kd, x), inv[x], mid[x] );
+            out[x] = v;
+            d = fabs( v - mid[x] );
+            max_delta = d > max_delta ? d : max_delta;
+        }
+        v = fix & STENCIL_FIX_LAST ? mid[n-1] : stencil_weighted(
+                STENCIL_W2(up, ku, n-2) + STENCIL_W2(mid, km, n-2) + STENCIL_W2(down, kd, n-2), inv[n-1], mid[n-1] );
+    }else{
+        // Top or bottom row, in stencil_row()'s order.
+        const double *other = up ? up : down;
+        const float *ko = up ? ku : kd;
+        v = fix & STENCIL_FIX_FIRST ? mid[0] : stencil_weighted(
+                STENCIL_KR(mid, km, 0) + STENCIL_KR(other, ko, 0) + STENCIL_KR(mid, km, 1) + STENCIL_KR(other, ko, 1),
+                inv[0], mid[0] );
+        out[0] = v;
+        max_delta = fabs( v - mid[0] );
+        if( up ){
+            for( x=1; x<(n-1); x++ ){
+                v = stencil_weighted( STENCIL_W3(up, ku, x) + STENCIL_W3(mid, km, x), inv[x], mid[x] );
+                out[x] = v;
+                d = fabs( v - mid[x] );
+                max_delta = d > max_delta ? d : max_delta;
+            }
+            v = fix & STENCIL_FIX_LAST ? mid[n-1] : stencil_weighted(
+                    STENCIL_KR(mid, km, n-1) + STENCIL_KR(up, ku, n-1) + STENCIL_KR(mid, km, n-2) + STENCIL_KR(up, ku, n-2),
+                    inv[n-1], mid[n-1] );
+        }else{
+            for( x=1; x<(n-1); x++ ){
+                v = stencil_weighted( STENCIL_W3(mid, km, x) + STENCIL_W3(down, kd, x), inv[x], mid[x] );
+                out[x] = v;
+                d = fabs( v - mid[x] );
+                max_delta = d > max_delta ? d : max_delta;
+            }
+            v = fix & STENCIL_FIX_LAST ? mid[n-1] : stencil_weighted(
+                    STENCIL_KR(mid, km, n-1) + STENCIL_KR(mid, km, n-2) + STENCIL_KR(down, kd, n-1) + STENCIL_KR(down, kd, n-2),
+                    inv[n-1], mid[n-1] );
+        }
+    }
+    out[n-1] = v;
+    d = fabs( v - mid[n-1] );
+    return d > max_delta ? d : max_delta;
+}
+
+// Fill rows [lo,hi) of inv for the weights k; see stencil_row_weighted().
+static inline void stencil_weight_norm(const float *k, double *inv, uint64_t n, uint64_t lo, uint64_t hi){
+    uint64_t x, y, yy, xx, y0, y1, x0, x1;
+    double sum;
+    for( y=lo; y<hi; y++ ){
+        y0 = y>0 ? y-1 : 0;
+        y1 = y<n-1 ? y+1 : n-1;
+        for( x=0; x<n; x++ ){
+            x0 = x>0 ? x-1 : 0;
+            x1 = x<n-1 ? x+1 : n-1;
+            sum = 0.0;
+            for( yy=y0; yy<=y1; yy++ ){
+                for( xx=x0; xx<=x1; xx++ ){
+                    sum += k[yy*n + xx];
+                }
+            }
+            inv[y*n + x] = sum > 0.0 ? 1.0 / sum : 0.0;
+        }
+    }
+}
+
+#endif
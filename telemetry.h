@@ -0,0 +1,72 @@
+/* Layout of the shared-memory stats block published by pjacobi and read
+ * by jstat.
+ *
+ * pjacobi creates the segment when PJACOBI_TELEMETRY names one (for
+ * example PJACOBI_TELEMETRY=/pjacobi), otherwise it writes to a private
+ * block nobody reads.  All fields are written with relaxed atomic stores
+ * once per iteration, outside calculate_avg(), and never read back by
+ * the solver, so publishing costs no syscalls and no locks.  A reader
+ * may see a mix of two consecutive iterations, which is fine for
+ * monitoring.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>     // size_t, offsetof
+#include <stdint.h>     // uint64_t and friends
+#include <string.h>     // memcpy(3)
+
+#define TELEMETRY_MAGIC     (0x4a544c4dULL)     // "JTLM"
+#define TELEMETRY_VERSION   (1ULL)
+#define TELEMETRY_ENV       "PJACOBI_TELEMETRY"
+
+// One per thread, on its own cache line so threads don't false share.
+struct telemetry_thread{
+    uint64_t iterations;
+    uint64_t calc_ns;       // Total time in calculate_avg().
+    uint64_t wait_ns;       // Total time waiting at the delta barrier.
+} __attribute__((aligned(64)));
+
+struct telemetry{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t n;
+    uint64_t num_threads;
+    uint64_t target_delta;  // Doubles are stored as their bit patterns.
+    uint64_t start_ns;      // CLOCK_REALTIME when the solve started.
+
+    uint64_t iteration;     // Updated by thread 0.
+    uint64_t delta;
+    uint64_t eta;           // Seconds to target_delta from the delta trend.
+    uint64_t update_ns;     // CLOCK_REALTIME of the last update.
+    uint64_t done;
+
+    struct telemetry_thread threads[] __attribute__((aligned(64)));
+};
+
+static inline size_t telemetry_size(uint64_t num_threads){
+    return offsetof(struct telemetry, threads) + num_threads * sizeof(struct telemetry_thread);
+}
+
+static inline void telemetry_store(uint64_t *field, uint64_t value){
+    __atomic_store_n( field, value, __ATOMIC_RELAXED );
+}
+
+static inline uint64_t telemetry_load(const uint64_t *field){
+    return __atomic_load_n( field, __ATOMIC_RELAXED );
+}
+
+static inline void telemetry_store_double(uint64_t *field, double value){
+    uint64_t bits;
+    memcpy( &bits, &value, sizeof(bits) );
+    telemetry_store( field, bits );
+}
+
+static inline double telemetry_load_double(const uint64_t *field){
+    uint64_t bits = telemetry_load( field );
+    double value;
+    memcpy( &value, &bits, sizeof(value) );
+    return value;
+}
+
+#endif
@@ -0,0 +1,158 @@
+/* Layout of the compressed grid files written by jacobi_save_tiles() and
+ * read by jtile.
+ *
+ * The grid is cut into tile x tile squares (narrower along the right and
+ * bottom edges), numbered row-major, and each is compressed on its own so
+ * that one can be read back without touching the rest.  A file is a
+ * struct tile_header, then one struct tile_entry per tile, then the tiles,
+ * all in host byte order.
+ *
+ * A tile's values are taken row by row and then
+ *
+ *      TILE_LOSSLESS   byte-shuffled: all the first bytes, then all the
+ *                      second bytes and so on, which lines up the sign,
+ *                      exponent and top mantissa bytes that neighbouring
+ *                      cells share
+ *      TILE_QUANTIZED  rounded to the nearest multiple of step, so off by
+ *                      at most step/2, and each multiple replaced by its
+ *                      difference from the one to its left, zigzagged so
+ *                      small negative differences are small numbers too,
+ *                      and byte-shuffled
+ *
+ * and deflated with zlib.
+ */
+#ifndef TILEFILE_H
+#define TILEFILE_H
+
+#include <math.h>
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint64_t and friends
+#include <string.h>     // memcpy(3)
+#include <zlib.h>       // compress2(3)
+
+#define TILE_MAGIC      "JTILEv1"
+#define TILE_LEVEL      (1)             // zlib level; higher costs far more time than it saves space.
+#define TILE_MAX_STEPS  (1152921504606846976.0)     // 2^60, so differences and zigzags fit.
+
+enum{
+    TILE_LOSSLESS       =0,
+    TILE_QUANTIZED      =1,
+    NUM_TILE_CODECS
+};
+
+struct tile_header{
+    char magic[8];
+    uint64_t n;
+    uint64_t tile;          // Edge of a full tile in cells.
+    uint64_t codec;
+    double step;            // TILE_QUANTIZED only.
+};
+
+struct tile_entry{
+    uint64_t offset;        // Of the tile from the start of the file.
+    uint64_t size;          // Compressed bytes.
+};
+
+static inline uint64_t tile_per_row(const struct tile_header *h){
+    return ( h->n + h->tile - 1 ) / h->tile;
+}
+
+static inline uint64_t tile_count(const struct tile_header *h){
+    return tile_per_row( h ) * tile_per_row( h );
+}
+
+// Top-left cell, width and height of tile i.
+static inline void tile_bounds(const struct tile_header *h, uint64_t i,
+        uint64_t *x0, uint64_t *y0, uint64_t *w, uint64_t *hgt){
+    *x0 = i % tile_per_row( h ) * h->tile;
+    *y0 = i / tile_per_row( h ) * h->tile;
+    *w = h->n - *x0 < h->tile ? h->n - *x0 : h->tile;
+    *hgt = h->n - *y0 < h->tile ? h->n - *y0 : h->tile;
+}
+
+// Room needed for one encoded tile, and for the scratch both directions use.
+static inline size_t tile_bound(const struct tile_header *h){
+    return compressBound( h->tile * h->tile * sizeof(uint64_t) );
+}
+
+static inline size_t tile_scratch(const struct tile_header *h){
+    return 2 * h->tile * h->tile * sizeof(uint64_t);
+}
+
+static inline int tile_header_ok(const struct tile_header *h){
+    return !memcmp( h->magic, TILE_MAGIC, sizeof(h->magic) ) && h->n > 0 && h->tile > 0 &&
+        h->tile <= h->n && h->codec < NUM_TILE_CODECS && ( h->codec != TILE_QUANTIZED || h->step > 0.0 );
+}
+
+/* Encode the w x hgt tile whose top-left cell is g[0], with rows stride
+ * apart, into dst, which has room for *size bytes, and set *size to the
+ * bytes used.  Returns 0, or -1 if a value can't be quantised at step.
+ */
+static inline int tile_encode(const struct tile_header *h, const double *g, uint64_t stride,
+        uint64_t w, uint64_t hgt, void *scratch, void *dst, size_t *size){
+    uint64_t *words = scratch, count = w * hgt, x, y, i, b;
+    unsigned char *shuffled = (unsigned char*)( words + count );
+    int64_t q, left;
+    double s;
+    uLongf len = *size;
+
+    for( y=0; y<hgt; y++ ){
+        if( h->codec == TILE_LOSSLESS ){
+            memcpy( &words[y*w], &g[y*stride], w * sizeof(double) );
+            continue;
+        }
+        for( x=0, left=0; x<w; x++ ){
+            s = g[y*stride + x] / h->step;
+            if( !( fabs( s ) < TILE_MAX_STEPS ) ){
+                return -1;
+            }
+            q = llround( s );
+            words[y*w + x] = ( (uint64_t)( q - left ) << 1 ) ^ (uint64_t)( ( q - left ) >> 63 );
+            left = q;
+        }
+    }
+    for( b=0; b<sizeof(uint64_t); b++ ){
+        for( i=0; i<count; i++ ){
+            shuffled[b*count + i] = ((const unsigned char*)&words[i])[b];
+        }
+    }
+    if( compress2( dst, &len, shuffled, count * sizeof(uint64_t), TILE_LEVEL ) != Z_OK ){
+        return -1;
+    }
+    *size = len;
+    return 0;
+}
+
+/* Decode a w x hgt tile of size bytes from src into out, with rows stride
+ * apart.  Returns 0, or -1 if the tile is corrupt.
+ */
+static inline int tile_decode(const struct tile_header *h, const void *src, size_t size,
+        uint64_t w, uint64_t hgt, void *scratch, double *out, uint64_t stride){
+    uint64_t *words = scratch, count = w * hgt, x, y, i, b, z;
+    unsigned char *shuffled = (unsigned char*)( words + count );
+    int64_t q;
+    uLongf len = count * sizeof(uint64_t);
+
+    if( uncompress( shuffled, &len, src, size ) != Z_OK || len != count * sizeof(uint64_t) ){
+        return -1;
+    }
+    for( b=0; b<sizeof(uint64_t); b++ ){
+        for( i=0; i<count; i++ ){
+            ((unsigned char*)&words[i])[b] = shuffled[b*count + i];
+        }
+    }
+    for( y=0; y<hgt; y++ ){
+        if( h->codec == TILE_LOSSLESS ){
+            memcpy( &out[y*stride], &words[y*w], w * sizeof(double) );
+            continue;
+        }
+        for( x=0, q=0; x<w; x++ ){
+            z = words[y*w + x];
+            q += (int64_t)( z >> 1 ) ^ -(int64_t)( z & 1 );
+            out[y*stride + x] = q * h->step;
+        }
+    }
+    return 0;
+}
+
+#endif